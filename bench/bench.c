@@ -0,0 +1,377 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+// キー入力の応答時間のベンチマーク。
+// 疑似端末の上でエディタを起動してキーを送り、画面 1 枚分の出力を書き終えるまでの時間を測る。
+// editorRenderFrame は最後にカーソルを表示する "\x1b[?25h" を書くので、これをフレームの終わりとみなす。
+//
+// 結果は 1 行 1 ワークロードの JSON (JSON Lines) で出力する。
+
+#define BENCH_FRAME_END "\x1b[?25h"
+#define BENCH_TIMEOUT_MS 60000
+#define BENCH_ROWS 24
+#define BENCH_COLS 80
+
+typedef struct {
+    int fd;
+    pid_t pid;
+    // BENCH_FRAME_END のどこまで一致しているか (read の境目をまたぐため)
+    int match;
+    // 前のフレームの終わりから読んだバイト数
+    long long bytes;
+    // 読んだがまだ調べていない出力 (1 回の read に複数のフレームが入ることがある)
+    char buf[65536];
+    int pos;
+    int len;
+} benchTerm;
+
+typedef struct {
+    char *name;
+    double *latency;
+    long long *bytes;
+    int count;
+    int cap;
+    double total;
+} benchResult;
+
+void usage();
+double benchNow();
+int benchSpawn(benchTerm *t, char *editor, char *file);
+int benchWaitFrames(benchTerm *t, int frames, long long *bytes);
+void benchWrite(benchTerm *t, char *s, int len);
+void benchQuit(benchTerm *t);
+void benchAddSample(benchResult *r, double latency, long long bytes);
+void benchKeys(benchTerm *t, benchResult *r, char *key, int len, int times);
+void benchReport(FILE *out, benchResult *r);
+int benchMakeFile(char *path, long lines);
+
+void usage() {
+    fprintf(stderr,
+        "Usage: bench.out [-l lines] [-n keys] [-o output] editor\n"
+        "  -l  生成するファイルの行数 (既定 1000000)\n"
+        "  -n  ワークロードごとのキー入力の回数 (既定 500)\n"
+        "  -o  結果の出力先 (既定は標準出力)\n");
+    exit(EXIT_FAILURE);
+}
+
+double benchNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/// 疑似端末を作ってエディタを起動する関数
+int benchSpawn(benchTerm *t, char *editor, char *file) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+        return -1;
+    }
+    char *slave_name = ptsname(master);
+    if (slave_name == NULL) {
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        return -1;
+    }
+    if (pid == 0) {
+        setsid();
+        int slave = open(slave_name, O_RDWR);
+        if (slave < 0) {
+            _exit(127);
+        }
+        struct winsize ws = {BENCH_ROWS, BENCH_COLS, 0, 0};
+        ioctl(slave, TIOCSWINSZ, &ws);
+        ioctl(slave, TIOCSCTTY, 0);
+        dup2(slave, STDIN_FILENO);
+        dup2(slave, STDOUT_FILENO);
+        dup2(slave, STDERR_FILENO);
+        close(master);
+        close(slave);
+        execl(editor, editor, file, (char *) NULL);
+        _exit(127);
+    }
+
+    t->fd = master;
+    t->pid = pid;
+    t->match = 0;
+    t->bytes = 0;
+    t->pos = 0;
+    t->len = 0;
+    return 0;
+}
+
+/// フレームの終わりを frames 回読むまで待つ関数
+// 読んだフレームのバイト数を bytes に足す。時間切れやエディタの終了時は -1 を返す。
+int benchWaitFrames(benchTerm *t, int frames, long long *bytes) {
+    static const char marker[] = BENCH_FRAME_END;
+    int marker_len = sizeof(marker) - 1;
+
+    while (frames > 0) {
+        if (t->pos == t->len) {
+            struct pollfd pfd = {t->fd, POLLIN, 0};
+            if (poll(&pfd, 1, BENCH_TIMEOUT_MS) <= 0) {
+                return -1;
+            }
+            ssize_t nread = read(t->fd, t->buf, sizeof(t->buf));
+            if (nread <= 0) {
+                return -1;
+            }
+            t->pos = 0;
+            t->len = nread;
+        }
+
+        while (t->pos < t->len && frames > 0) {
+            char c = t->buf[t->pos++];
+            t->bytes++;
+            if (c == marker[t->match]) {
+                t->match++;
+            } else {
+                t->match = (c == marker[0]) ? 1 : 0;
+            }
+            if (t->match == marker_len) {
+                t->match = 0;
+                frames--;
+                *bytes += t->bytes;
+                t->bytes = 0;
+            }
+        }
+    }
+    return 0;
+}
+
+void benchWrite(benchTerm *t, char *s, int len) {
+    while (len > 0) {
+        ssize_t written = write(t->fd, s, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        s += written;
+        len -= written;
+    }
+}
+
+void benchQuit(benchTerm *t) {
+    kill(t->pid, SIGKILL);
+    waitpid(t->pid, NULL, 0);
+    close(t->fd);
+}
+
+void benchAddSample(benchResult *r, double latency, long long bytes) {
+    if (r->count == r->cap) {
+        r->cap = r->cap ? r->cap * 2 : 256;
+        r->latency = realloc(r->latency, sizeof(double) * r->cap);
+        r->bytes = realloc(r->bytes, sizeof(long long) * r->cap);
+    }
+    r->latency[r->count] = latency;
+    r->bytes[r->count] = bytes;
+    r->count++;
+    r->total += latency;
+}
+
+/// key を 1 回ずつ送り、そのたびにフレームが書き終わるまでの時間を測る関数
+void benchKeys(benchTerm *t, benchResult *r, char *key, int len, int times) {
+    while (times-- > 0) {
+        long long bytes = 0;
+        double start = benchNow();
+        benchWrite(t, key, len);
+        if (benchWaitFrames(t, 1, &bytes) < 0) {
+            fprintf(stderr, "%s: editor did not respond\n", r->name);
+            return;
+        }
+        benchAddSample(r, benchNow() - start, bytes);
+    }
+}
+
+int benchCompareDouble(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+int benchCompareLong(const void *a, const void *b) {
+    long long x = *(const long long *) a;
+    long long y = *(const long long *) b;
+    return (x > y) - (x < y);
+}
+
+/// 結果を 1 行の JSON として書き出す関数
+void benchReport(FILE *out, benchResult *r) {
+    if (r->count == 0) {
+        fprintf(out, "{\"workload\":\"%s\",\"samples\":0}\n", r->name);
+        return;
+    }
+    qsort(r->latency, r->count, sizeof(double), benchCompareDouble);
+    qsort(r->bytes, r->count, sizeof(long long), benchCompareLong);
+
+    long long bytes_total = 0;
+    for (int i = 0; i < r->count; i++) {
+        bytes_total += r->bytes[i];
+    }
+
+    fprintf(out,
+        "{\"workload\":\"%s\",\"samples\":%d,\"total_ms\":%.3f,"
+        "\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f,"
+        "\"bytes_per_frame_avg\":%.1f,\"bytes_per_frame_p50\":%lld,\"bytes_per_frame_max\":%lld}\n",
+        r->name, r->count, r->total * 1e3,
+        r->latency[(r->count - 1) * 50 / 100] * 1e6,
+        r->latency[(r->count - 1) * 99 / 100] * 1e6,
+        r->latency[r->count - 1] * 1e6,
+        (double) bytes_total / r->count,
+        r->bytes[(r->count - 1) * 50 / 100],
+        r->bytes[r->count - 1]);
+    fflush(out);
+}
+
+/// C のソースに似た行を lines 行書いたファイルを作る関数
+int benchMakeFile(char *path, long lines) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        return -1;
+    }
+    for (long i = 0; i < lines; i++) {
+        switch (i % 8) {
+            case 0: fprintf(fp, "/* block %ld */\n", i); break;
+            case 1: fprintf(fp, "static int value_%ld = %ld;\n", i, i * 7); break;
+            case 2: fprintf(fp, "\tif (value_%ld > 0) {\n", i - 1); break;
+            case 3: fprintf(fp, "\t\tprintf(\"%%d\\n\", value_%ld); // print\n", i - 2); break;
+            case 4: fprintf(fp, "\t}\n"); break;
+            case 5: fprintf(fp, "\n"); break;
+            case 6: fprintf(fp, "char *name_%ld = \"keditor benchmark line\";\n", i); break;
+            default: fprintf(fp, "double ratio_%ld = %ld.5;\n", i, i); break;
+        }
+    }
+    return fclose(fp);
+}
+
+int main(int argc, char **argv) {
+    long lines = 1000000;
+    int keys = 500;
+    FILE *out = stdout;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "l:n:o:")) != -1) {
+        switch (opt) {
+            case 'l':
+                lines = atol(optarg);
+                break;
+            case 'n':
+                keys = atoi(optarg);
+                break;
+            case 'o':
+                out = fopen(optarg, "w");
+                if (!out) {
+                    perror(optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            default:
+                usage();
+        }
+    }
+    if (optind >= argc || lines < 1 || keys < 1) {
+        usage();
+    }
+    char *editor = argv[optind];
+
+    char path[] = "/tmp/keditor-bench-XXXXXX.c";
+    int tmpfd = mkstemps(path, 2);
+    if (tmpfd < 0) {
+        perror("mkstemps");
+        return EXIT_FAILURE;
+    }
+    close(tmpfd);
+    if (benchMakeFile(path, lines) < 0) {
+        perror("benchMakeFile");
+        unlink(path);
+        return EXIT_FAILURE;
+    }
+
+    benchTerm t;
+    if (benchSpawn(&t, editor, path) < 0) {
+        perror("benchSpawn");
+        unlink(path);
+        return EXIT_FAILURE;
+    }
+
+    // 起動してファイルを読み込み、最初の画面を書き終えるまで
+    benchResult open_result = {"open", NULL, NULL, 0, 0, 0};
+    long long bytes = 0;
+    double start = benchNow();
+    if (benchWaitFrames(&t, 1, &bytes) < 0) {
+        fprintf(stderr, "editor did not draw the first frame\n");
+        benchQuit(&t);
+        unlink(path);
+        return EXIT_FAILURE;
+    }
+    benchAddSample(&open_result, benchNow() - start, bytes);
+    benchReport(out, &open_result);
+
+    // 1 文字ずつの入力。ときどき改行を入れる。
+    benchResult typing = {"typing", NULL, NULL, 0, 0, 0};
+    char text[] = "int x = 42; /* typed */";
+    for (int i = 0; i < keys; i++) {
+        int len = sizeof(text) - 1;
+        char *key = (i % (len + 1) == len) ? "\r" : &text[i % (len + 1)];
+        benchKeys(&t, &typing, key, 1, 1);
+    }
+    benchReport(out, &typing);
+
+    // 貼り付け。keys 文字を一度に書き込み、フレームごとの間隔を測る。
+    benchResult paste = {"paste", NULL, NULL, 0, 0, 0};
+    char *chunk = malloc(keys);
+    for (int i = 0; i < keys; i++) {
+        chunk[i] = (i % 40 == 39) ? '\r' : 'a' + (i % 26);
+    }
+    double prev = benchNow();
+    benchWrite(&t, chunk, keys);
+    for (int i = 0; i < keys; i++) {
+        bytes = 0;
+        if (benchWaitFrames(&t, 1, &bytes) < 0) {
+            fprintf(stderr, "paste: editor did not respond\n");
+            break;
+        }
+        double now = benchNow();
+        benchAddSample(&paste, now - prev, bytes);
+        prev = now;
+    }
+    free(chunk);
+    benchReport(out, &paste);
+
+    // ファイルの先へページ送り
+    benchResult page_down = {"page_down", NULL, NULL, 0, 0, 0};
+    benchKeys(&t, &page_down, "\x1b[6~", 4, keys);
+    benchReport(out, &page_down);
+
+    // 保存
+    benchResult save = {"save", NULL, NULL, 0, 0, 0};
+    benchKeys(&t, &save, "\x13", 1, 3);
+    benchReport(out, &save);
+
+    benchQuit(&t);
+    unlink(path);
+    if (out != stdout) {
+        fclose(out);
+    }
+    return EXIT_SUCCESS;
+}
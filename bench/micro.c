@@ -0,0 +1,327 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+
+#include "../editor.h"
+
+// 行の操作のマイクロベンチマーク。editor.c を直接リンクして、1 操作あたりの時間を測る。
+// 行の長さ、タブの割合、行数を変えながら、ウォームアップの後に同じ測定を繰り返し、中央値と最小値を出す。
+//
+// 結果は 1 行 1 測定の JSON (JSON Lines) で出力する。
+
+typedef struct {
+    // 1 行の文字数
+    int row_len;
+    // タブ文字の割合 (%)
+    int tab_pct;
+    // バッファの行数
+    int rows;
+    // 1 回の測定で行う操作の回数
+    int ops;
+} microParams;
+
+typedef double (*microFunc)(microParams *p);
+
+typedef struct {
+    char *name;
+    microFunc func;
+    // 行数を変えて測るか (行数に依存しない操作は 1 つの行数だけで測る)
+    bool sweep_rows;
+} microBench;
+
+int repetitions = 7;
+int warmups = 2;
+// 最適化で消されないように、結果をここに書き込む
+volatile long long micro_sink;
+
+double microNow();
+char *microMakeLine(microParams *p, unsigned int seed);
+void microFillBuffer(editorConfig *E, microParams *p);
+double microAppendRow(microParams *p);
+double microRowInsertChar(microParams *p);
+double microRowDeleteChar(microParams *p);
+double microUpdateRow(microParams *p);
+double microRowCxtoRx(microParams *p);
+double microRowsToString(microParams *p);
+double microAbAppend(microParams *p);
+void microRun(microBench *bench, microParams *p);
+int microPinCpu(int cpu);
+
+double microNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/// row_len 文字で、tab_pct % がタブの行を作る関数
+char *microMakeLine(microParams *p, unsigned int seed) {
+    char *line = malloc(p->row_len + 1);
+    for (int i = 0; i < p->row_len; i++) {
+        seed = seed * 1103515245 + 12345;
+        if ((int) ((seed >> 16) % 100) < p->tab_pct) {
+            line[i] = '\t';
+        } else {
+            line[i] = 'a' + (seed >> 16) % 26;
+        }
+    }
+    line[p->row_len] = '\0';
+    return line;
+}
+
+void microFillBuffer(editorConfig *E, microParams *p) {
+    editorInit(E, 22, 80);
+    char *line = microMakeLine(p, 1);
+    for (int i = 0; i < p->rows; i++) {
+        editorAppendRow(E, E->numrows, line, p->row_len);
+    }
+    free(line);
+}
+
+// 以下の関数は、測定する操作だけにかかった時間を秒で返す。
+
+double microAppendRow(microParams *p) {
+    editorConfig E;
+    editorInit(&E, 22, 80);
+    char *line = microMakeLine(p, 1);
+
+    double start = microNow();
+    for (int i = 0; i < p->rows; i++) {
+        editorAppendRow(&E, E.numrows, line, p->row_len);
+    }
+    double elapsed = microNow() - start;
+
+    micro_sink += E.numrows;
+    free(line);
+    editorFree(&E);
+    return elapsed;
+}
+
+double microRowInsertChar(microParams *p) {
+    editorConfig E;
+    microFillBuffer(&E, p);
+    erow *row = &E.row[0];
+
+    double start = microNow();
+    for (int i = 0; i < p->ops; i++) {
+        editorRowInsertChar(&E, row, row->size / 2, (i % 10 == 0) ? '\t' : 'x');
+    }
+    double elapsed = microNow() - start;
+
+    micro_sink += editorRowRsize(row);
+    editorFree(&E);
+    return elapsed;
+}
+
+double microRowDeleteChar(microParams *p) {
+    editorConfig E;
+    microFillBuffer(&E, p);
+    erow *row = &E.row[0];
+    // 消す分だけ先に伸ばしておく
+    for (int i = 0; i < p->ops; i++) {
+        editorRowInsertChar(&E, row, row->size, 'x');
+    }
+
+    double start = microNow();
+    for (int i = 0; i < p->ops; i++) {
+        editorRowDeleteChar(&E, row, row->size / 2);
+    }
+    double elapsed = microNow() - start;
+
+    micro_sink += editorRowRsize(row);
+    editorFree(&E);
+    return elapsed;
+}
+
+double microUpdateRow(microParams *p) {
+    editorConfig E;
+    microFillBuffer(&E, p);
+
+    double start = microNow();
+    for (int i = 0; i < p->ops; i++) {
+        editorUpdateRow(&E, &E.row[i % E.numrows]);
+    }
+    double elapsed = microNow() - start;
+
+    micro_sink += editorRowRsize(&E.row[0]);
+    editorFree(&E);
+    return elapsed;
+}
+
+double microRowCxtoRx(microParams *p) {
+    editorConfig E;
+    microFillBuffer(&E, p);
+    erow *row = &E.row[0];
+    long long sum = 0;
+
+    double start = microNow();
+    for (int i = 0; i < p->ops; i++) {
+        sum += editorRowCxtoRx(row, row->size - (i % (row->size + 1)));
+    }
+    double elapsed = microNow() - start;
+
+    micro_sink += sum;
+    editorFree(&E);
+    return elapsed;
+}
+
+double microRowsToString(microParams *p) {
+    editorConfig E;
+    microFillBuffer(&E, p);
+
+    double start = microNow();
+    int len;
+    char *buf = editorRowsToString(&E, &len);
+    double elapsed = microNow() - start;
+
+    micro_sink += len + buf[len / 2];
+    editorMemFree(buf);
+    editorFree(&E);
+    return elapsed;
+}
+
+double microAbAppend(microParams *p) {
+    char *line = microMakeLine(p, 1);
+    abuf ab = ABUF_INIT;
+
+    double start = microNow();
+    for (int i = 0; i < p->ops; i++) {
+        abAppend(&ab, line, p->row_len);
+    }
+    double elapsed = microNow() - start;
+
+    micro_sink += ab.len;
+    abFree(&ab);
+    free(line);
+    return elapsed;
+}
+
+int microCompareDouble(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/// ウォームアップの後に repetitions 回測定し、1 操作あたりの時間を JSON で書き出す関数
+void microRun(microBench *bench, microParams *p) {
+    // 1 回の測定あたりの操作の回数。行単位の操作は行数、それ以外は ops。
+    int ops = (bench->func == microAppendRow) ? p->rows :
+              (bench->func == microRowsToString) ? 1 : p->ops;
+
+    for (int i = 0; i < warmups; i++) {
+        bench->func(p);
+    }
+
+    double *samples = malloc(sizeof(double) * repetitions);
+    for (int i = 0; i < repetitions; i++) {
+        samples[i] = bench->func(p) / ops * 1e9;
+    }
+    qsort(samples, repetitions, sizeof(double), microCompareDouble);
+
+    printf("{\"bench\":\"%s\",\"row_len\":%d,\"tab_pct\":%d,\"rows\":%d,\"ops\":%d,"
+           "\"reps\":%d,\"ns_per_op_median\":%.2f,\"ns_per_op_min\":%.2f,\"ns_per_op_max\":%.2f}\n",
+           bench->name, p->row_len, p->tab_pct, p->rows, ops, repetitions,
+           samples[repetitions / 2], samples[0], samples[repetitions - 1]);
+    fflush(stdout);
+    free(samples);
+}
+
+/// 測定のぶれを減らすため、このプロセスを 1 つの CPU に固定する関数
+int microPinCpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+}
+
+microBench BENCHES[] = {
+    {"editorAppendRow", microAppendRow, true},
+    {"editorRowInsertChar", microRowInsertChar, false},
+    {"editorRowDeleteChar", microRowDeleteChar, false},
+    {"editorUpdateRow", microUpdateRow, false},
+    {"editorRowCxtoRx", microRowCxtoRx, false},
+    {"editorRowsToString", microRowsToString, true},
+    {"abAppend", microAbAppend, false},
+    {NULL, NULL, false},
+};
+
+int ROW_LENS[] = {8, 80, 1024};
+int TAB_PCTS[] = {0, 10, 50};
+int ROW_COUNTS[] = {1000, 100000, 1000000};
+
+#define MICRO_LEN(array) ((int) (sizeof(array) / sizeof(array[0])))
+
+int main(int argc, char **argv) {
+    int cpu = 0;
+    int ops = 10000;
+    char *only = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:w:c:n:b:")) != -1) {
+        switch (opt) {
+            case 'r':
+                repetitions = atoi(optarg);
+                break;
+            case 'w':
+                warmups = atoi(optarg);
+                break;
+            case 'c':
+                cpu = atoi(optarg);
+                break;
+            case 'n':
+                ops = atoi(optarg);
+                break;
+            case 'b':
+                only = optarg;
+                break;
+            default:
+                fprintf(stderr,
+                    "Usage: micro.out [-r reps] [-w warmups] [-c cpu] [-n ops] [-b bench]\n"
+                    "  -c  固定する CPU (-1 で固定しない)\n"
+                    "  -b  指定した名前の測定だけを行う\n");
+                return EXIT_FAILURE;
+        }
+    }
+    if (repetitions < 1 || warmups < 0 || ops < 1) {
+        fprintf(stderr, "invalid arguments\n");
+        return EXIT_FAILURE;
+    }
+    if (cpu >= 0 && microPinCpu(cpu) < 0) {
+        perror("sched_setaffinity");
+    }
+
+    for (int b = 0; BENCHES[b].name; b++) {
+        if (only && strcmp(only, BENCHES[b].name)) {
+            continue;
+        }
+        for (int l = 0; l < MICRO_LEN(ROW_LENS); l++) {
+            for (int t = 0; t < MICRO_LEN(TAB_PCTS); t++) {
+                int nrows = BENCHES[b].sweep_rows ? MICRO_LEN(ROW_COUNTS) : 1;
+                for (int r = 0; r < nrows; r++) {
+                    // メモリを使いすぎる組み合わせ (256 MB 超) は飛ばす
+                    if (BENCHES[b].sweep_rows &&
+                        (long long) ROW_COUNTS[r] * ROW_LENS[l] > (256LL << 20)) {
+                        continue;
+                    }
+                    microParams p = {
+                        ROW_LENS[l],
+                        TAB_PCTS[t],
+                        BENCHES[b].sweep_rows ? ROW_COUNTS[r] : 64,
+                        ops,
+                    };
+                    microRun(&BENCHES[b], &p);
+                }
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
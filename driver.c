@@ -0,0 +1,244 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "editor.h"
+#include "trace.h"
+
+// 端末を使わずにエディタを動かすドライバ。
+// キー操作を書いたスクリプトを editor.c にそのまま流し込み、1 キーごとに画面を組み立てる。
+//
+// スクリプトの書式 (1 行 1 命令、# から始まる行は無視する)
+//   type <文字列>        文字列を 1 文字ずつ入力する
+//   key <名前> [回数]    特殊キーを入力する (ENTER, ESC, BACKSPACE, DELETE, UP, DOWN, LEFT, RIGHT,
+//                        HOME, END, PAGE_UP, PAGE_DOWN, CTRL-<英字>)
+
+typedef struct {
+    char *name;
+    int key;
+} driverKeyName;
+
+driverKeyName KEY_NAMES[] = {
+    {"ENTER", '\r'},
+    {"ESC", '\x1b'},
+    {"BACKSPACE", BACKSPACE},
+    {"DELETE", DELETE_KEY},
+    {"UP", ARROW_UP},
+    {"DOWN", ARROW_DOWN},
+    {"LEFT", ARROW_LEFT},
+    {"RIGHT", ARROW_RIGHT},
+    {"HOME", HOME_KEY},
+    {"END", END_KEY},
+    {"PAGE_UP", PAGE_UP},
+    {"PAGE_DOWN", PAGE_DOWN},
+    {NULL, 0},
+};
+
+typedef struct {
+    editorConfig E;
+    bool render;
+    bool quit;
+    long keys;
+    long frames;
+    long long bytes;
+} driverState;
+
+void usage();
+int driverParseKey(char *name);
+void driverFeedKey(driverState *st, int c);
+int driverRunScript(driverState *st, FILE *fp);
+double driverNow();
+
+void usage() {
+    fprintf(stderr,
+        "Usage: driver.out [-r rows] [-c cols] [-n] [-d] [-i] [-m] [-t trace] script [file]\n"
+        "  -r, -c  画面の大きさ (既定 24x80)\n"
+        "  -n      画面を組み立てない\n"
+        "  -d      終了時にバッファの内容を標準出力に書き出す\n"
+        "  -i      同じ内容の行の文字列を共有して読み込む\n"
+        "  -m      終了時にメモリの使用量を標準エラー出力に書き出す\n"
+        "  -t      Chrome Trace Event 形式のトレースを書き出す\n");
+    exit(EXIT_FAILURE);
+}
+
+/// key 命令のキーの名前をキーの値に変換する関数
+int driverParseKey(char *name) {
+    if (!strncmp(name, "CTRL-", 5) && name[5] != '\0' && name[6] == '\0') {
+        return CTRL_KEY(name[5]);
+    }
+    for (int i = 0; KEY_NAMES[i].name; i++) {
+        if (!strcmp(name, KEY_NAMES[i].name)) {
+            return KEY_NAMES[i].key;
+        }
+    }
+    return -1;
+}
+
+/// キーを 1 つ処理して、端末のフロントエンドと同じように画面を組み立てる関数
+void driverFeedKey(driverState *st, int c) {
+    if (st->quit) {
+        return;
+    }
+    st->keys++;
+
+    switch (editorProcessKey(&st->E, c)) {
+        case EDITOR_ACTION_QUIT:
+            st->quit = true;
+            return;
+        case EDITOR_ACTION_SAVE:
+            // プロンプトは出せないので、ファイル名が無ければ保存しない
+            editorSave(&st->E);
+            break;
+    }
+
+    if (st->render) {
+        abuf ab = ABUF_INIT;
+        TRACE_BEGIN(span);
+        editorRenderFrame(&st->E, &ab);
+        TRACE_END("frame", span);
+        st->frames++;
+        st->bytes += ab.len;
+        abFree(&ab);
+    }
+}
+
+/// スクリプトを最後まで (または Ctrl-Q で終了するまで) 実行する関数
+int driverRunScript(driverState *st, FILE *fp) {
+    char *line = NULL;
+    size_t linecap = 0;
+    ssize_t linelen;
+    int lineno = 0;
+
+    while (!st->quit && (linelen = getline(&line, &linecap, fp)) != -1) {
+        lineno++;
+        while (linelen > 0 && (line[linelen - 1] == '\r' || line[linelen - 1] == '\n')) {
+            line[--linelen] = '\0';
+        }
+        if (linelen == 0 || line[0] == '#') {
+            continue;
+        }
+
+        if (!strncmp(line, "type ", 5)) {
+            for (char *p = &line[5]; *p; p++) {
+                driverFeedKey(st, (unsigned char) *p);
+            }
+        } else if (!strncmp(line, "key ", 4)) {
+            char name[32];
+            int times = 1;
+            if (sscanf(&line[4], "%31s %d", name, &times) < 1) {
+                fprintf(stderr, "line %d: missing key name\n", lineno);
+                free(line);
+                return -1;
+            }
+            int key = driverParseKey(name);
+            if (key < 0) {
+                fprintf(stderr, "line %d: unknown key %s\n", lineno, name);
+                free(line);
+                return -1;
+            }
+            while (times-- > 0) {
+                driverFeedKey(st, key);
+            }
+        } else {
+            fprintf(stderr, "line %d: unknown command\n", lineno);
+            free(line);
+            return -1;
+        }
+    }
+
+    free(line);
+    return 0;
+}
+
+double driverNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    int rows = 24;
+    int cols = 80;
+    bool dump = false;
+    bool memstats = false;
+    bool intern = false;
+    driverState st;
+    memset(&st, 0, sizeof(st));
+    st.render = true;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:c:ndimt:")) != -1) {
+        switch (opt) {
+            case 'r':
+                rows = atoi(optarg);
+                break;
+            case 'c':
+                cols = atoi(optarg);
+                break;
+            case 'n':
+                st.render = false;
+                break;
+            case 'd':
+                dump = true;
+                break;
+            case 'i':
+                intern = true;
+                break;
+            case 'm':
+                memstats = true;
+                break;
+            case 't':
+                traceInit(optarg);
+                break;
+            default:
+                usage();
+        }
+    }
+    if (optind >= argc || rows < 3 || cols < 1) {
+        usage();
+    }
+
+    editorInit(&st.E, rows - 2, cols);
+    st.E.intern_lines = intern;
+
+    if (optind + 1 < argc && editorOpen(&st.E, argv[optind + 1]) < 0) {
+        perror("editorOpen");
+        return EXIT_FAILURE;
+    }
+
+    FILE *fp = fopen(argv[optind], "r");
+    if (!fp) {
+        perror("script");
+        return EXIT_FAILURE;
+    }
+
+    double start = driverNow();
+    int ret = driverRunScript(&st, fp);
+    double elapsed = driverNow() - start;
+    fclose(fp);
+
+    fprintf(stderr,
+        "keys %ld frames %ld bytes %lld rows %d dirty %d elapsed %.6f s\n",
+        st.keys, st.frames, st.bytes, st.E.numrows, st.E.dirty, elapsed);
+
+    if (dump) {
+        int len;
+        char *buf = editorRowsToString(&st.E, &len);
+        fwrite(buf, 1, len, stdout);
+        editorMemFree(buf);
+    }
+    if (memstats) {
+        editorMemReport(stderr, 0);
+    }
+
+    editorFree(&st.E);
+    return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
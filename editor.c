@@ -0,0 +1,4450 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <pthread.h>
+#ifdef KEDITOR_MEM_ACCOUNT
+#include <malloc.h>
+#endif
+
+#include "editor.h"
+#include "trace.h"
+#include "lz.h"
+#include "sidecar.h"
+
+long editor_allocs = 0;
+editorMemStats editor_mem[MEM_MAX];
+long editor_mem_slack = 0;
+long editor_mem_shared = 0;
+
+#ifdef KEDITOR_MEM_ACCOUNT
+// editorMalloc で確保したブロックの先頭に置く情報。
+// long double と重ねて、後ろに続く領域の配置 (alignment) を malloc と同じに保つ。
+typedef union {
+    struct {
+        size_t size;
+        int category;
+    } info;
+    long double align;
+} editorMemHeader;
+#endif
+
+char *MEM_CATEGORY_NAMES[MEM_MAX] = {"rows", "text", "render", "hl", "frame", "scratch", "arena", "cold", "cache"};
+
+// 展開した圧縮ブロックのキャッシュと、最後に読んだ順番を付けるための時計
+editorColdBlock *cold_cache[KEDITOR_COLD_CACHE_BLOCKS];
+unsigned long cold_clock = 0;
+
+// ハイライトの種類ごとの色。端末の色の種類に応じてどれか 1 つを使う。
+typedef struct {
+    int basic;
+    int index256;
+    unsigned char r, g, b;
+} editorColor;
+
+editorColor HL_COLORS[HL_MAX] = {
+    [HL_NORMAL] = {39, -1, 0, 0, 0},
+    [HL_COMMENT] = {36, 73, 106, 153, 85},
+    [HL_MLCOMMENT] = {36, 73, 106, 153, 85},
+    [HL_KEYWORD1] = {33, 178, 197, 134, 192},
+    [HL_KEYWORD2] = {32, 72, 78, 201, 176},
+    [HL_STRING] = {35, 174, 206, 145, 120},
+    [HL_NUMBER] = {31, 151, 181, 206, 168},
+};
+
+// 起動時に作るハイライトの種類ごとのエスケープシーケンス。
+// 同じ色になる種類は同じ文字列を指すので、ポインタを比べれば色が変わるか分かる。
+char *hl_sgr[HL_MAX];
+int hl_sgr_len[HL_MAX];
+
+// is_separator 用の判定表 (editorInitSeparators で作る)
+bool separator_table[256];
+
+/* Filetypes */
+
+char *C_HL_extensions[] = {".c", ".h", ".cpp", NULL};
+// 末尾に | が付いているものは型として別の色で表示する
+char *C_HL_keywords[] = {
+    "switch", "if", "while", "for", "break", "continue", "return", "else",
+    "struct", "union", "typedef", "static", "enum", "class", "case",
+
+    "int|", "long|", "double|", "float|", "char|", "unsigned|", "signed|",
+    "void|", "bool|", NULL
+};
+
+editorSyntax HLDB[] = {
+    {
+        "c",
+        C_HL_extensions,
+        C_HL_keywords,
+        "//", "/*", "*/",
+        HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS,
+        NULL, 0, 0, 0
+    },
+};
+
+#define HLDB_ENTRIES (sizeof(HLDB) / sizeof(HLDB[0]))
+
+
+/* Editor */
+
+/// エディタの状態を初期化する関数
+// screenrows, screencols にはステータスバーとメッセージバーを除いた大きさを渡す。
+void editorInit(editorConfig *E, int screenrows, int screencols) {
+    // ハイライトの表などは全てのエディタで共有するので、最初の一度だけ作る。
+    static bool tables_ready = false;
+    if (!tables_ready) {
+        editorInitSeparators();
+        editorInitColors();
+        for (unsigned int j = 0; j < HLDB_ENTRIES; j++) {
+            editorSyntaxCompileKeywords(&HLDB[j]);
+        }
+        tables_ready = true;
+    }
+
+    E->cx = 0;
+    E->cy = 0;
+    E->rx = 0;
+    E->numrows = 0;
+    E->row = NULL;
+    E->rowoff = 0;
+    E->coloff = 0;
+    E->filename = NULL;
+    E->statusmsg[0] = '\0';
+    E->statusmsg_time = 0;
+    E->dirty = 0;
+    E->quit_times = KEDITOR_QUIT_TIMES;
+    E->syntax = NULL;
+    E->hl_frontier = 0;
+    E->arena = NULL;
+    E->intern_lines = false;
+    E->intern = NULL;
+    E->load = NULL;
+    E->cache_dir = NULL;
+    E->cold_cursor = 0;
+    E->file_offset = 0;
+    E->file_tail = -1;
+    E->follow_pending = false;
+    E->follow_scroll = false;
+    E->file_stamp.valid = false;
+    E->overwrite_confirmed = false;
+    E->windows = NULL;
+    E->numwindows = 0;
+    E->window = 0;
+    E->window_key = false;
+    E->filter = NULL;
+    E->folds = NULL;
+    E->fold_mark = -1;
+    E->fold_key = false;
+    memset(E->anchors, 0, sizeof(E->anchors));
+    memset(E->marks, 0, sizeof(E->marks));
+    E->mark_key = 0;
+    E->damage_from = INT_MAX;
+    E->damage_to = 0;
+    memset(&E->perf, 0, sizeof(E->perf));
+    E->perf.alloc_mark = editor_allocs;
+    E->screenrows = screenrows;
+    E->screencols = screencols;
+}
+
+/// エディタが持っているメモリを全て解放する関数
+void editorFree(editorConfig *E) {
+    if (E->load) {
+        free(E->load->line);
+        fclose(E->load->fp);
+        if (E->load->indexing) {
+            sidecarFree(&E->load->index);
+        }
+        editorMemFree(E->load->block_row);
+        editorMemFree(E->load->block_done);
+        editorMemFree(E->load);
+        E->load = NULL;
+        editorInternEnd(E);
+    }
+    for (int at = 0; at < E->numrows; at++) {
+        editorFreeRow(&E->row[at]);
+    }
+    editorMemFree(E->row);
+    editorArenaFree(E);
+    free(E->filename);
+    free(E->cache_dir);
+    editorMemFree(E->windows);
+    editorFilterClear(E);
+    editorFoldFreeTree(E->folds);
+    E->folds = NULL;
+    for (int kind = 0; kind < ANCHOR_KINDS; kind++) {
+        editorAnchorClear(E, kind);
+    }
+    E->row = NULL;
+    E->numrows = 0;
+    E->filename = NULL;
+    E->cache_dir = NULL;
+    E->windows = NULL;
+    E->numwindows = 0;
+    E->window = 0;
+}
+
+/// 端末から届いたバイト列 seq の先頭を 1 つのキーに変換する関数
+// used には消費したバイト数を入れる。エスケープシーケンスとして解釈できなければ '\x1b' を返す。
+int editorDecodeKey(const char *seq, int len, int *used) {
+    *used = 1;
+    if (len <= 0) {
+        return '\0';
+    }
+    if (seq[0] != '\x1b') {
+        return (unsigned char) seq[0];
+    }
+    if (len < 3) {
+        return '\x1b';
+    }
+
+    if (seq[1] == '[') {
+        if (seq[2] >= '0' && seq[2] <= '9') {
+            if (len < 4) {
+                return '\x1b';
+            }
+            // page キーと Delete キーの parse
+            if (seq[3] == '~') {
+                *used = 4;
+                switch (seq[2]) {
+                    case '1': return HOME_KEY; // 他プラットフォーム対応
+                    case '4': return END_KEY; // 他プラットフォーム対応
+                    case '3':
+                        return DELETE_KEY;
+                    case '5':
+                        return PAGE_UP;
+                    case '6':
+                        return PAGE_DOWN;
+                    case '7': return HOME_KEY; // 他プラットフォーム対応
+                    case '8': return END_KEY; // 他プラットフォーム対応
+                }
+            }
+            *used = 1;
+        } else {
+            *used = 3;
+            switch (seq[2]) {
+                // 矢印キーの parse
+                case 'A':
+                    return ARROW_UP;
+                case 'C':
+                    return ARROW_RIGHT;
+                case 'B':
+                    return ARROW_DOWN;
+                case 'D':
+                    return ARROW_LEFT;
+                // Home, End キーの parse
+                case 'H':
+                    return HOME_KEY;
+                case 'F':
+                    return END_KEY;
+            }
+            *used = 1;
+        }
+    } else if (seq[1] == 'O') {
+        *used = 3;
+        switch (seq[2]) {
+            case 'H': return HOME_KEY; // 他プラットフォーム対応
+            case 'F': return END_KEY; // 他プラットフォーム対応
+        }
+        *used = 1;
+    }
+    return '\x1b';
+}
+
+/// 入力キーに対応する処理を呼び出す関数
+// 終了と保存はフロントエンドごとにやり方が違うので、editorAction を返して任せる。
+int editorProcessKey(editorConfig *E, int c) {
+    int action = EDITOR_ACTION_NONE;
+    // 読み込んでいる途中は、1 画面先 (ブロックごとに読み込んでいる時は 1 画面前も) に移動しても足りるだけの行を読み込んでおく
+    editorLoadUntil(E, E->cy + 2 * E->screenrows + 1);
+    editorLoadRows(E, E->cy - E->screenrows, E->cy + 2 * E->screenrows + 1);
+
+    // Ctrl-W の次のキーはウィンドウの操作
+    if (E->window_key) {
+        E->window_key = false;
+        editorSetStatusMessage(E, "");
+        editorWindowCommand(E, c);
+        return EDITOR_ACTION_NONE;
+    }
+    // Ctrl-F の次のキーは折りたたみの操作
+    if (E->fold_key) {
+        E->fold_key = false;
+        editorSetStatusMessage(E, "");
+        editorFoldCommand(E, c);
+        return EDITOR_ACTION_NONE;
+    }
+    // Ctrl-K の次のキーはマークとブックマークの操作
+    if (E->mark_key) {
+        int pending = E->mark_key;
+        E->mark_key = 0;
+        editorSetStatusMessage(E, "");
+        editorAnchorCommand(E, pending, c);
+        return EDITOR_ACTION_NONE;
+    }
+
+    switch (c) {
+        // TODO
+        case '\r':
+            editorInsertNewLine(E);
+            break;
+        case CTRL_KEY('q'):
+            if (E->dirty > 0 && E->quit_times > 0) {
+                editorSetStatusMessage(
+                    E,
+                    "WARNING!!! File has unsaved changes. "
+                    "Press Ctrl-Q %d more times to quit.",
+                    E->quit_times
+                );
+                E->quit_times--;
+                return EDITOR_ACTION_NONE;
+            }
+            return EDITOR_ACTION_QUIT;
+        // 保存
+        case CTRL_KEY('s'):
+            // 開いた後に他のプロセスが書き換えたファイルは、もう一度押すまで上書きしない
+            if (!E->overwrite_confirmed && editorFileChanged(E)) {
+                editorSetStatusMessage(
+                    E,
+                    "WARNING!!! %s changed on disk. "
+                    "Press Ctrl-S again to overwrite.",
+                    E->filename
+                );
+                E->overwrite_confirmed = true;
+                E->quit_times = KEDITOR_QUIT_TIMES;
+                return EDITOR_ACTION_NONE;
+            }
+            action = EDITOR_ACTION_SAVE;
+            break;
+        // バッファの切り替え
+        case CTRL_KEY('n'):
+            action = EDITOR_ACTION_NEXT_BUFFER;
+            break;
+        case CTRL_KEY('b'):
+            action = EDITOR_ACTION_PREV_BUFFER;
+            break;
+        // 表示する行の絞り込み (絞り込んでいる時は解除する)
+        case CTRL_KEY('g'):
+            if (E->filter) {
+                editorFilterClear(E);
+                editorSetStatusMessage(E, "Filter cleared");
+            } else {
+                action = EDITOR_ACTION_FILTER;
+            }
+            break;
+        // ウィンドウの操作 (次のキーで何をするかを選ぶ)
+        case CTRL_KEY('w'):
+            E->window_key = true;
+            editorSetStatusMessage(E, "Ctrl-W: s = split | v = vsplit | w = next | c = close | o = only");
+            break;
+        // 折りたたみの操作 (次のキーで何をするかを選ぶ)
+        case CTRL_KEY('f'):
+            E->fold_key = true;
+            editorSetStatusMessage(E, "Ctrl-F: c = close | o = open | a = toggle | m = mark | f = fold to mark | R = open all");
+            break;
+        // マークとブックマークの操作 (次のキーで何をするかを選ぶ)
+        case CTRL_KEY('k'):
+            E->mark_key = 'k';
+            editorSetStatusMessage(E, "Ctrl-K: m = mark | ' = jump | ]/[ = next/prev mark | b = bookmark | n/p = next/prev | c = clear");
+            break;
+        // 画面の左端か右端にカーソルを移動させる
+        case HOME_KEY:
+            E->cx = 0;
+            break;
+        case END_KEY:
+            if (E->cy < E->numrows) {
+                E->cx = E->row[E->cy].size;
+            }
+            break;
+        // TODO
+        case BACKSPACE:
+        case CTRL_KEY('h'):
+        case DELETE_KEY:
+            // delete キーが押された時はカーソルを右にずらしてバックスペースで削除する実装にする。
+            // すなはちカーソルにある文字を削除する。
+            if (c == DELETE_KEY) {
+                editorMoveCursor(E, ARROW_RIGHT);
+            }
+            editorDeleteChar(E);
+            break;
+        // 画面の一番上か一番下のカーソルを移動させる
+        case PAGE_UP:
+        case PAGE_DOWN:
+            {
+                if (c == PAGE_UP) {
+                    E->cy = E->rowoff;
+                } else if (c == PAGE_DOWN) {
+                    E->cy = editorViewRow(E, editorViewIndex(E, E->rowoff) + E->screenrows - 1);
+                }
+                if (E->cy > E->numrows) {
+                    E->cy = E->numrows;
+                }
+
+                int times = E->screenrows;
+                while (times--) {
+                    editorMoveCursor(E, c == PAGE_DOWN ? ARROW_DOWN : ARROW_UP);
+                }
+            }
+            break;
+        case ARROW_UP:
+        case ARROW_RIGHT:
+        case ARROW_DOWN:
+        case ARROW_LEFT:
+            editorMoveCursor(E, c);
+            break;
+        // 性能の計測結果の表示を切り替える
+        case CTRL_KEY('p'):
+#ifdef KEDITOR_PERF
+            E->perf.visible = !E->perf.visible;
+#else
+            editorSetStatusMessage(E, "Performance HUD is not compiled in (build with -DKEDITOR_PERF)");
+#endif
+            break;
+        // メモリの使用量の表の表示を切り替える
+        case CTRL_KEY('t'):
+#ifdef KEDITOR_MEM_ACCOUNT
+            E->perf.mem_visible = !E->perf.mem_visible;
+#else
+            editorSetStatusMessage(E, "Memory stats are not compiled in (build with MEM=1)");
+#endif
+            break;
+        // TODO
+        // 画面を全て書き直す
+        case CTRL_KEY('l'):
+            editorWindowRedrawAll(E);
+            break;
+        case '\x1b':
+            break;
+        default:
+            editorInsertChar(E, c);
+            break;
+    }
+
+    editorRevealCursor(E);
+
+    E->quit_times = KEDITOR_QUIT_TIMES;
+    E->overwrite_confirmed = false;
+    return action;
+}
+
+/// カーソルのある行を表示する関数
+// 絞り込んでいる時は、編集してパターンを含まなくなった行や、改行で作った行でもカーソルのある間は表示する。
+// 畳んだ範囲に隠れた行にカーソルが移った時 (隠れた行で改行した時や、マークに移った時など) は、その範囲を開く。
+void editorRevealCursor(editorConfig *E) {
+    if (E->filter) {
+        editorFilterCursor(E);
+    }
+    if (E->filter == NULL && E->folds && editorFoldHiddenBefore(E, E->cy + 1) > editorFoldHiddenBefore(E, E->cy)) {
+        editorFoldOpen(E, E->cy);
+    }
+}
+
+/// 画面 1 枚分の出力を ab に組み立てる関数
+// 実際に書き込むのはフロントエンドの役割。
+void editorRenderFrame(editorConfig *E, abuf *ab) {
+    if (E->numwindows > 0) {
+        editorRenderWindows(E, ab);
+        return;
+    }
+
+    TRACE_BEGIN(scroll);
+    editorScroll(E);
+    TRACE_END("scroll", scroll);
+
+    // 画面に見えている行だけはここで確実にハイライトしておく。
+    TRACE_BEGIN(syntax);
+    editorSyntaxUpdateView(E);
+    TRACE_END("syntax", syntax);
+
+    TRACE_BEGIN(draw);
+    abAppend(ab, "\x1b[?25l", 6);
+    abAppend(ab, "\x1b[H", 3);
+
+    editorDrawRows(E, ab);
+    editorDrawStatusBar(E, ab);
+    editorDrawMessageBar(E, ab);
+
+    char buf[32];
+    // 絶対値 (E->cy) から相対値 (原点がウィンドウ) に変更する必要がある。
+    int y = editorViewIndex(E, E->cy) - editorViewIndex(E, E->rowoff);
+    snprintf(buf, sizeof(buf), "\x1b[%d;%dH", y + 1, (E->rx - E->coloff) + 1);
+    abAppend(ab, buf, strlen(buf));
+    abAppend(ab, "\x1b[?25h", 6);
+    TRACE_END("draw", draw);
+    E->damage_from = INT_MAX;
+    E->damage_to = 0;
+}
+
+/// キー入力を待っている間の処理 (フロントエンドが入力の無い時に呼ぶ)
+// 画面外の行のハイライトを進め、画面から離れた行を圧縮する。
+void editorIdle(editorConfig *E) {
+    editorSyntaxIdle(E);
+    editorColdIdle(E);
+}
+
+/// カーソルの座標を表す変数を変更する関数
+void editorMoveCursor(editorConfig *E, int key) {
+    erow *row = (E->cy >= E->numrows) ? NULL : &E->row[E->cy];
+    // 上下の行は、表示している行 (絞り込んでいる時は一致する行) の中で数える
+    int at = editorViewIndex(E, E->cy);
+
+    switch (key) {
+        case ARROW_UP:
+            if (at > 0) {
+                E->cy = editorViewRow(E, at - 1);
+            }
+            break;
+        case ARROW_DOWN:
+            if (E->cy < E->numrows) {
+                E->cy = editorViewRow(E, at + 1);
+            }
+            break;
+        case ARROW_RIGHT:
+            if (row && E->cx < row->size) {
+                E->cx++;
+            } else if (row && E->cx == row->size) {
+                E->cy = editorViewRow(E, at + 1);
+                E->cx = 0;
+            }
+            break;
+        case ARROW_LEFT:
+            if (E->cx != 0) {
+                E->cx--;
+            } else if (at > 0) {
+                // E->cx > 0 の評価式にしないとファイルの一番先頭にカーソルがある状態で Left Arrow を押すと、異常終了してしまう。
+                E->cy = editorViewRow(E, at - 1);
+                E->cx = E->row[E->cy].size;
+            }
+            break;
+    }
+
+    // 行末から行末の短い行に移動した時に、カーソルが行末に移動するようなロジック
+    row = (E->cy >= E->numrows) ? NULL : &E->row[E->cy];
+    int rowlen = row ? row->size : 0;
+    if (E->cx > rowlen) {
+        E->cx = rowlen;
+    }
+}
+
+void editorDrawRows(editorConfig *E, abuf *ab) {
+    // 端末に今設定されている色。前のフレームはステータスバーで色を戻して終わっている。
+    int current_hl = HL_NORMAL;
+    int rows_drawn = 0;
+    // 画面の y 行目には、rowoff から数えて y 番目に表示する行 (絞り込んでいる時は一致する行) を書く
+    int top = editorViewIndex(E, E->rowoff);
+    // 画面を分けている時は、行ごとにウィンドウの中の位置へ移動して書く
+    editorWindow *win = E->numwindows > 0 ? &E->windows[E->window] : NULL;
+    bool right = false;
+    if (win) {
+        int rows, cols;
+        editorWindowArea(E, &rows, &cols);
+        right = win->left + win->cols < cols;
+    }
+    int y = 0;
+    for (y = 0; y < E->screenrows; y++) {
+        int filerow = editorViewRow(E, top + y);
+        if (win) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "\x1b[%d;%dH", win->top + y + 1, win->left + 1);
+            abAppend(ab, buf, strlen(buf));
+        }
+#ifdef KEDITOR_MEM_ACCOUNT
+        // メモリの使用量の表を表示している間は、テキストの代わりにそれを出す
+        if (E->perf.mem_visible) {
+            char line[160];
+            int linelen = editorMemFormatLine(y, E->perf.rss_kb, line, sizeof(line));
+            if (linelen > E->screencols) {
+                linelen = E->screencols;
+            }
+            editorSetColor(ab, &current_hl, HL_NORMAL);
+            if (linelen > 0) {
+                abAppend(ab, line, linelen);
+            }
+            editorDrawLineEnd(E, ab, &current_hl, linelen > 0 ? linelen : 0, right);
+            continue;
+        }
+#endif
+        // 書いた桁数 (右隣にウィンドウがある時に、残りを空白で埋めるのに使う)
+        int width = 0;
+        if (filerow >= E->numrows) {
+            editorSetColor(ab, &current_hl, HL_NORMAL);
+            // Welcome Messsage を描画
+            if (E->numrows == 0 && y == E->screenrows / 3) {
+                char welcome[80];
+                int welcome_length = snprintf(welcome, sizeof(welcome), "Keditor -- version %s", KEDITOR_VERSION);
+                if (welcome_length > E->screencols) {
+                    welcome_length = E->screencols;
+                }
+                int padding = (E->screencols - welcome_length) / 2;
+                width = padding + welcome_length;
+                if (padding) {
+                    abAppend(ab, "~", 1);
+                    padding--;
+                }
+                while (padding--) {
+                    abAppend(ab, " ", 1);
+                }
+
+                abAppend(ab, welcome, welcome_length);
+            } else {
+                abAppend(ab, "~", 1);
+                width = 1;
+            }
+        } else {
+            int rsize = editorRowRsize(&E->row[filerow]);
+            int len = rsize - E->coloff;
+            if (len < 0) {
+                len = 0;
+            }
+            if (len > E->screencols) {
+                len = E->screencols;
+            }
+            rows_drawn++;
+            char *c = &editorRowRender(&E->row[filerow])[E->coloff];
+            unsigned char *hl = &editorRowHl(&E->row[filerow])[E->coloff];
+            // 同じ色が続く間はまとめて書き込む
+            int j = 0;
+            while (j < len) {
+                int run = 1;
+                while (j + run < len && hl_sgr[hl[j + run]] == hl_sgr[hl[j]]) {
+                    run++;
+                }
+                editorSetColor(ab, &current_hl, hl[j]);
+                abAppend(ab, &c[j], run);
+                j += run;
+            }
+            width = len;
+            // 畳んだ範囲の見出しの行には、隠している行数を書き足す
+            editorFold *fold = E->filter == NULL && E->folds ? editorFoldFind(E, filerow) : NULL;
+            if (fold && fold->start == filerow && len == rsize - E->coloff) {
+                char note[32];
+                int notelen = snprintf(note, sizeof(note), " [+%d lines]", fold->end - fold->start);
+                if (notelen > E->screencols - width) {
+                    notelen = E->screencols - width;
+                }
+                editorSetColor(ab, &current_hl, HL_COMMENT);
+                abAppend(ab, note, notelen);
+                width += notelen;
+            }
+        }
+
+        editorDrawLineEnd(E, ab, &current_hl, width, right);
+    }
+    editorSetColor(ab, &current_hl, HL_NORMAL);
+    E->perf.rows_drawn = rows_drawn;
+}
+
+/// width 桁を書いた行の残りを消す関数
+// 行削除のエスケープシーケンス (\x1b[K) で、画面を消さずに上書きで書き込める。
+// ただし右隣にウィンドウがある (right) 時はそこまで消えてしまうので、空白で埋めて区切りの列を書く。
+void editorDrawLineEnd(editorConfig *E, abuf *ab, int *current_hl, int width, bool right) {
+    if (right) {
+        static char spaces[] = "                                ";
+        editorSetColor(ab, current_hl, HL_NORMAL);
+        while (width < E->screencols) {
+            int run = E->screencols - width;
+            run = run < (int) sizeof(spaces) - 1 ? run : (int) sizeof(spaces) - 1;
+            abAppend(ab, spaces, run);
+            width += run;
+        }
+        abAppend(ab, "|", 1);
+    } else {
+        abAppend(ab, "\x1b[K", 3);
+    }
+    if (E->numwindows == 0) {
+        abAppend(ab, "\r\n", 2);
+    }
+}
+
+// E->cx を E->rx に変換する関数
+// Tab 文字が存在するときは、
+int editorRowCxtoRx(erow *row, int cx) {
+    //
+    char *chars = editorRowChars(row);
+    int rx = 0;
+    for (int i = 0; i < cx; i++) {
+        if (chars[i] == '\t') {
+            rx += (KEDITOR_TAB_STOP - 1) - (rx % KEDITOR_TAB_STOP);
+        }
+        rx++;
+    }
+    return rx;
+}
+
+void editorScroll(editorConfig *E) {
+    // 絞り込んでいる時は、表示していない行にあるカーソルと画面の先頭を、次に表示する行に移す
+    if (E->filter) {
+        E->cy = editorViewRow(E, editorViewIndex(E, E->cy));
+        E->rowoff = editorViewRow(E, editorViewIndex(E, E->rowoff));
+        int rowlen = E->cy < E->numrows ? E->row[E->cy].size : 0;
+        if (E->cx > rowlen) {
+            E->cx = rowlen;
+        }
+    } else if (E->folds) {
+        // 畳んでいる時は、隠れた行にある画面の先頭とカーソル (他のウィンドウで畳んだ時) を見出しの行に移す
+        editorFold *fold = editorFoldFind(E, E->rowoff);
+        if (fold) {
+            E->rowoff = fold->start;
+        }
+        fold = editorFoldFind(E, E->cy);
+        if (fold && E->cy > fold->start) {
+            E->cy = fold->start;
+            E->cx = 0;
+        }
+    }
+
+    // ブロックごとに読み込んでいる時は、カーソルの行を読み込んでから位置を求める
+    editorLoadRows(E, E->cy, E->cy + 1);
+    E->rx = 0;
+    if (E->cy < E->numrows) {
+        E->rx = editorRowCxtoRx(&E->row[E->cy], E->cx);
+    }
+
+    // y 方向 (表示している行の中での位置で比べる)
+    int cy = editorViewIndex(E, E->cy);
+    int top = editorViewIndex(E, E->rowoff);
+    if (cy < top) {
+        E->rowoff = E->cy;
+    }
+    if (cy >= E->screenrows + top) {
+        E->rowoff = editorViewRow(E, cy - E->screenrows + 1);
+    }
+    // 画面に見える行を読み込んでおく (絞り込んでいる時に見える行は、一致した時に読み込んである)
+    if (E->filter == NULL) {
+        editorLoadRows(E, E->rowoff, editorViewRow(E, editorViewIndex(E, E->rowoff) + E->screenrows));
+    }
+    // x 方向
+    if (E->rx < E->coloff) {
+        E->coloff = E->rx;
+    }
+    if (E->rx >= E->screencols + E->coloff) {
+        E->coloff = E->rx - E->screencols + 1;
+    }
+}
+
+void editorDrawStatusBar(editorConfig *E, abuf *ab) {
+    editorDrawWindowStatusBar(E, ab, true);
+}
+
+/// E に読み込んであるウィンドウのステータスバーを書く関数
+// 画面を分けている時はウィンドウの下に書き、入力を受け取っていない (focused でない) ウィンドウは反転表示にする。
+void editorDrawWindowStatusBar(editorConfig *E, abuf *ab, bool focused) {
+    editorWindow *win = E->numwindows > 0 ? &E->windows[E->window] : NULL;
+    bool right = false;
+    if (win) {
+        int rows, cols;
+        editorWindowArea(E, &rows, &cols);
+        right = win->left + win->cols < cols;
+        char buf[32];
+        snprintf(buf, sizeof(buf), "\x1b[%d;%dH", win->top + win->rows + 1, win->left + 1);
+        abAppend(ab, buf, strlen(buf));
+    }
+    if (focused) {
+        abAppend(ab, "\x1b[46m", 5);
+    } else {
+        abAppend(ab, "\x1b[7m", 4);
+    }
+    // 左端に出すメッセージ
+    char status[80];
+    int len = snprintf(
+        status,
+        sizeof(status),
+        "%.20s - %d lines %s",
+        E->filename ? E->filename : "[No Name]" ,
+        E->numrows,
+        E->dirty > 0 ? "( modified )" : ""
+    );
+    // 読み込んでいる途中は進み具合を出す
+    if (E->load && E->load->size > 0 && len < (int) sizeof(status)) {
+        len += snprintf(
+            status + len, sizeof(status) - len, " (loading %d%%)", (int) (E->load->pos * 100 / E->load->size)
+        );
+        len = len < (int) sizeof(status) ? len : (int) sizeof(status) - 1;
+    }
+    // 絞り込んでいる時は、その文字列と一致する行数を出す
+    if (E->filter && len < (int) sizeof(status)) {
+        len += snprintf(
+            status + len, sizeof(status) - len, " [filter \"%.16s\": %d]", E->filter->pattern, E->filter->count
+        );
+        len = len < (int) sizeof(status) ? len : (int) sizeof(status) - 1;
+    }
+    len = len > E->screencols ? E->screencols : len;
+    abAppend(ab, status, len);
+    // 右端に出すメッセージ
+    char rstatus[80];
+    int rlen = snprintf(
+        rstatus, sizeof(rstatus), "%s | %d/%d",
+        E->syntax ? E->syntax->filetype : "no ft", E->cy + 1, E->numrows
+    );
+    while (len < E->screencols) {
+        if (E->screencols - len == rlen) {
+            abAppend(ab, rstatus, rlen);
+            break;
+        } else {
+            abAppend(ab, " ", 1);
+            len++;
+        }
+    }
+    abAppend(ab, "\x1b[m", 3);
+    if (right) {
+        abAppend(ab, "|", 1);
+    }
+    if (win == NULL) {
+        abAppend(ab, "\r\n", 2);
+    }
+}
+
+void editorSetStatusMessage(editorConfig *E, const char *fmt, ...) {
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(E->statusmsg, sizeof(E->statusmsg), fmt, ap);
+    va_end(ap);
+    E->statusmsg_time = time(NULL);
+}
+
+void editorDrawMessageBar(editorConfig *E, abuf *ab) {
+    abAppend(ab, "\x1b[K", 3);
+#ifdef KEDITOR_PERF
+    // 計測結果を表示している間は、メッセージの代わりにそれを出す
+    if (E->perf.visible) {
+        char hud[160];
+        int hudlen = snprintf(
+            hud, sizeof(hud),
+            "key %.2f draw %.2f out %.2f ms | %dB rows %d hl %d | alloc %ld rss %ldK | q %d",
+            E->perf.key_ms, E->perf.render_ms, E->perf.write_ms,
+            E->perf.frame_bytes, E->perf.rows_drawn, E->perf.rows_highlighted,
+            E->perf.allocs, E->perf.rss_kb, E->perf.input_queue
+        );
+        if (hudlen > E->screencols) {
+            hudlen = E->screencols;
+        }
+        abAppend(ab, "\x1b[7m", 4);
+        abAppend(ab, hud, hudlen);
+        abAppend(ab, "\x1b[m", 3);
+        return;
+    }
+#endif
+    int msglen = strlen(E->statusmsg);
+    if (msglen > E->screencols) {
+        msglen = E->screencols;
+    }
+    if (msglen && time(NULL) - E->statusmsg_time < 5) {
+        abAppend(ab, E->statusmsg, msglen);
+    }
+}
+
+void abAppend(abuf *ab, char *s, int len) {
+    char *new = editorRealloc(MEM_FRAME, ab->buf, ab->len + len);
+
+    if (new == NULL) {
+        return;
+    }
+
+    memcpy(&new[ab->len], s, len);
+    ab->buf = new;
+    ab->len += len;
+}
+
+void abFree(abuf *ab) {
+    editorMemFree(ab->buf);
+}
+
+#ifdef KEDITOR_MEM_ACCOUNT
+/// 分類ごとの使用量に bytes と blocks を足し込む関数 (減らす時は負の値を渡す)
+void editorMemAccount(int category, long bytes, long blocks, long slack) {
+    editorMemStats *stats = &editor_mem[category];
+    stats->bytes += bytes;
+    stats->blocks += blocks;
+    if (stats->bytes > stats->peak) {
+        stats->peak = stats->bytes;
+    }
+    editor_mem_slack += slack;
+}
+#endif
+
+/// category に分類してメモリを確保する関数
+// KEDITOR_MEM_ACCOUNT の時はブロックの先頭に大きさと分類を置いて、解放の時に差し引けるようにする。
+void *editorMalloc(int category, size_t size) {
+    PERF_COUNT(editor_allocs);
+#ifdef KEDITOR_MEM_ACCOUNT
+    editorMemHeader *header = malloc(sizeof(editorMemHeader) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+    header->info.size = size;
+    header->info.category = category;
+    editor_mem[category].allocs++;
+    editorMemAccount(category, size, 1, malloc_usable_size(header) - size);
+    return header + 1;
+#else
+    (void) category;
+    return malloc(size);
+#endif
+}
+
+/// editorMalloc で確保したメモリの大きさを変える関数
+// ptr が NULL でなければ、分類は確保した時のものを引き継ぐ。
+void *editorRealloc(int category, void *ptr, size_t size) {
+#ifdef KEDITOR_MEM_ACCOUNT
+    if (ptr == NULL) {
+        return editorMalloc(category, size);
+    }
+    PERF_COUNT(editor_allocs);
+    editorMemHeader *header = (editorMemHeader *) ptr - 1;
+    size_t oldsize = header->info.size;
+    long oldslack = malloc_usable_size(header) - oldsize;
+
+    header = realloc(header, sizeof(editorMemHeader) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+    header->info.size = size;
+    category = header->info.category;
+    editor_mem[category].allocs++;
+    editorMemAccount(category, (long) size - (long) oldsize, 0,
+                     (long) (malloc_usable_size(header) - size) - oldslack);
+    return header + 1;
+#else
+    (void) category;
+    PERF_COUNT(editor_allocs);
+    return realloc(ptr, size);
+#endif
+}
+
+/// editorMalloc で確保したメモリを解放する関数
+void editorMemFree(void *ptr) {
+#ifdef KEDITOR_MEM_ACCOUNT
+    if (ptr == NULL) {
+        return;
+    }
+    editorMemHeader *header = (editorMemHeader *) ptr - 1;
+    size_t size = header->info.size;
+    editorMemAccount(header->info.category, -(long) size, -1,
+                     -(long) (malloc_usable_size(header) - size));
+    free(header);
+#else
+    free(ptr);
+#endif
+}
+
+/// メモリの使用量の表の line 行目を buf に書き込んで、その長さを返す関数 (表が終われば -1)
+// Ctrl-T の表示と、終了時の書き出しの両方で使う。
+int editorMemFormatLine(int line, long rss_kb, char *buf, int size) {
+    if (line == 0) {
+        return snprintf(buf, size, "%-10s %12s %10s %12s %10s", "memory", "bytes", "blocks", "peak", "allocs");
+    }
+    if (line <= MEM_MAX) {
+        editorMemStats *stats = &editor_mem[line - 1];
+        return snprintf(buf, size, "%-10s %12ld %10ld %12ld %10ld",
+                        MEM_CATEGORY_NAMES[line - 1], stats->bytes, stats->blocks, stats->peak, stats->allocs);
+    }
+
+    long bytes = 0;
+    long blocks = 0;
+    long allocs = 0;
+    for (int i = 0; i < MEM_MAX; i++) {
+        bytes += editor_mem[i].bytes;
+        blocks += editor_mem[i].blocks;
+        allocs += editor_mem[i].allocs;
+    }
+    switch (line - MEM_MAX) {
+        case 1:
+            return snprintf(buf, size, "%-10s %12ld %10ld %12s %10ld", "total", bytes, blocks, "", allocs);
+        case 2:
+            // ヘッダと malloc の切り上げの分。malloc 自身が持つ管理領域は含まない。
+            return snprintf(buf, size, "%-10s %12ld", "overhead", editor_mem_slack);
+        case 3:
+            if (editor_mem_shared > 0) {
+                return snprintf(buf, size, "%-10s %12ld", "shared", editor_mem_shared);
+            }
+            return 0;
+        case 4:
+            if (rss_kb > 0) {
+                return snprintf(buf, size, "%-10s %12ld", "rss", rss_kb * 1024);
+            }
+            return 0;
+    }
+    return -1;
+}
+
+/// メモリの使用量の表を fp に書き出す関数
+void editorMemReport(FILE *fp, long rss_kb) {
+#ifdef KEDITOR_MEM_ACCOUNT
+    char line[160];
+    int len;
+    for (int i = 0; (len = editorMemFormatLine(i, rss_kb, line, sizeof(line))) >= 0; i++) {
+        if (len > 0) {
+            fprintf(fp, "%s\n", line);
+        }
+    }
+#else
+    (void) rss_kb;
+    fprintf(fp, "memory accounting is not compiled in (build with MEM=1)\n");
+#endif
+}
+
+double editorPerfNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/// フレームを書き終えた時に、そのフレームまでの集計を確定させる関数
+void editorPerfEndFrame(editorConfig *E) {
+    E->perf.rows_highlighted = E->perf.hl_count;
+    E->perf.hl_count = 0;
+    E->perf.allocs = editor_allocs - E->perf.alloc_mark;
+    E->perf.alloc_mark = editor_allocs;
+}
+
+/* Windows */
+
+/// from 行目から to 行目の手前までの表示が変わったことを記録する関数 (行がずれた時は to に INT_MAX を渡す)
+// 画面を分けている時は、次のフレームでこの範囲を表示しているウィンドウだけを書き直す。
+void editorDamage(editorConfig *E, int from, int to) {
+    if (from < E->damage_from) {
+        E->damage_from = from;
+    }
+    if (to > E->damage_to) {
+        E->damage_to = to;
+    }
+}
+
+/// 分けたウィンドウを 1 枚の出力に組み立てる関数
+// 後のウィンドウのハイライトで先に書いたウィンドウの行の色が変わることがあるので、
+// 全てのウィンドウのスクロールとハイライトを済ませてから書く。
+// テキストは、前のフレームから表示が変わった行を含むか、スクロールしたウィンドウだけを書き直す。
+// ステータスバーは行数や変更の有無、入力を受け取っているウィンドウが変わるので、毎回全て書く。
+void editorRenderWindows(editorConfig *E, abuf *ab) {
+    int focus = E->window;
+    editorWindowSave(E);
+
+    TRACE_BEGIN(scroll);
+    for (int i = 0; i < E->numwindows; i++) {
+        editorWindowLoad(E, i);
+        editorScroll(E);
+        editorSyntaxUpdateView(E);
+        editorWindowSave(E);
+    }
+    TRACE_END("scroll", scroll);
+
+    TRACE_BEGIN(draw);
+    abAppend(ab, "\x1b[?25l", 6);
+    int rows_drawn = 0;
+    for (int i = 0; i < E->numwindows; i++) {
+        editorWindowLoad(E, i);
+        editorWindow *win = &E->windows[i];
+        int end = editorViewRow(E, editorViewIndex(E, E->rowoff) + E->screenrows);
+        bool damaged = E->damage_from < end && E->damage_to > E->rowoff;
+        if (win->redraw || damaged || E->perf.mem_visible ||
+            win->drawn_rowoff != E->rowoff || win->drawn_coloff != E->coloff) {
+            editorDrawRows(E, ab);
+            rows_drawn += E->perf.rows_drawn;
+            win->redraw = false;
+            win->drawn_rowoff = E->rowoff;
+            win->drawn_coloff = E->coloff;
+        }
+        editorDrawWindowStatusBar(E, ab, i == focus);
+    }
+    editorWindowLoad(E, focus);
+    E->perf.rows_drawn = rows_drawn;
+
+    // メッセージバーは全てのウィンドウの下に書く
+    int rows, cols;
+    editorWindowArea(E, &rows, &cols);
+    char buf[32];
+    snprintf(buf, sizeof(buf), "\x1b[%d;1H", rows + 2);
+    abAppend(ab, buf, strlen(buf));
+    editorDrawMessageBar(E, ab);
+
+    editorWindow *win = &E->windows[focus];
+    snprintf(
+        buf, sizeof(buf), "\x1b[%d;%dH",
+        win->top + editorViewIndex(E, E->cy) - editorViewIndex(E, E->rowoff) + 1, win->left + (E->rx - E->coloff) + 1
+    );
+    abAppend(ab, buf, strlen(buf));
+    abAppend(ab, "\x1b[?25h", 6);
+    TRACE_END("draw", draw);
+    E->damage_from = INT_MAX;
+    E->damage_to = 0;
+}
+
+/// Ctrl-W の次に押したキー c に対応するウィンドウの操作をする関数
+void editorWindowCommand(editorConfig *E, int c) {
+    switch (c) {
+        case 's':
+        case 'v':
+            if (editorWindowSplit(E, c == 'v') < 0) {
+                editorSetStatusMessage(E, "Window is too small to split");
+            }
+            break;
+        case 'w':
+        case CTRL_KEY('w'):
+        case 'W':
+            if (E->numwindows == 0) {
+                editorSetStatusMessage(E, "No other windows");
+                break;
+            }
+            editorWindowSelect(E, (E->window + (c == 'W' ? E->numwindows - 1 : 1)) % E->numwindows);
+            break;
+        case 'c':
+            if (editorWindowClose(E) < 0) {
+                editorSetStatusMessage(E, "Can't close the last window");
+            }
+            break;
+        case 'o':
+            editorWindowOnly(E);
+            break;
+    }
+}
+
+/// 入力を受け取っているウィンドウを上下 (vertical なら左右) の 2 つに分ける関数
+// 新しいウィンドウは下 (右) に作り、同じ位置を同じカーソルで表示する。入力は上 (左) のウィンドウが受け取る。
+// 分けると 1 行 (1 桁) も表示できなくなる時は -1 を返す。
+int editorWindowSplit(editorConfig *E, bool vertical) {
+    // 大きさを確かめてから確保する (分けられない時は、ウィンドウが 1 つの状態に戻さずに済む)
+    int rows = E->numwindows ? E->windows[E->window].rows : E->screenrows;
+    int cols = E->numwindows ? E->windows[E->window].cols : E->screencols;
+    // 縦に分ける時は間に区切りの列を 1 つ置き、横に分ける時はステータスバーを含めた高さを分ける
+    if (vertical ? cols < 3 : rows + 1 < 4) {
+        return -1;
+    }
+    if (E->numwindows == 0) {
+        E->windows = editorMalloc(MEM_SCRATCH, sizeof(editorWindow));
+        E->windows[0].top = 0;
+        E->windows[0].left = 0;
+        E->windows[0].rows = E->screenrows;
+        E->windows[0].cols = E->screencols;
+        E->numwindows = 1;
+        E->window = 0;
+    }
+    editorWindowSave(E);
+
+    editorWindow split = E->windows[E->window];
+    editorWindow *win = &E->windows[E->window];
+    if (vertical) {
+        int first = win->cols - (win->cols - 1) / 2 - 1;
+        split.left = win->left + first + 1;
+        split.cols = win->cols - first - 1;
+        win->cols = first;
+    } else {
+        int height = win->rows + 1;
+        int first = height - height / 2;
+        split.top = win->top + first;
+        split.rows = height - first - 1;
+        win->rows = first - 1;
+    }
+
+    E->windows = editorRealloc(MEM_SCRATCH, E->windows, sizeof(editorWindow) * (E->numwindows + 1));
+    memmove(
+        &E->windows[E->window + 2], &E->windows[E->window + 1],
+        sizeof(editorWindow) * (E->numwindows - E->window - 1)
+    );
+    E->windows[E->window + 1] = split;
+    E->numwindows++;
+    E->windows[E->window].redraw = true;
+    E->windows[E->window + 1].redraw = true;
+    editorWindowLoad(E, E->window);
+    return 0;
+}
+
+/// 入力を受け取っているウィンドウを閉じて、空いた所を隣のウィンドウに広げる関数
+// ウィンドウは分けて作ったものなので、上下左右のどれかの辺は、隣のウィンドウの辺でちょうど覆われている。
+// その隣のウィンドウ (1 つとは限らない) を広げ、最初のものに入力を移す。最後の 1 つは閉じずに -1 を返す。
+int editorWindowClose(editorConfig *E) {
+    if (E->numwindows < 2) {
+        return -1;
+    }
+    editorWindowSave(E);
+    editorWindow closed = E->windows[E->window];
+    int next = -1;
+    // 下、上、右、左の順に調べる
+    for (int side = 0; side < 4 && next < 0; side++) {
+        bool horizontal = side < 2;
+        int covered = 0;
+        for (int i = 0; i < E->numwindows; i++) {
+            editorWindow *win = &E->windows[i];
+            bool adjacent;
+            if (horizontal) {
+                adjacent = (side == 0 ? win->top == closed.top + closed.rows + 1 : win->top + win->rows + 1 == closed.top) &&
+                           win->left >= closed.left && win->left + win->cols <= closed.left + closed.cols;
+            } else {
+                adjacent = (side == 2 ? win->left == closed.left + closed.cols + 1 : win->left + win->cols + 1 == closed.left) &&
+                           win->top >= closed.top && win->top + win->rows <= closed.top + closed.rows;
+            }
+            if (i != E->window && adjacent) {
+                // 隣同士のウィンドウは、区切りの列 (ステータスバー) の分だけ離れている
+                covered += horizontal ? win->cols + 1 : win->rows + 1;
+            }
+        }
+        if (covered != (horizontal ? closed.cols + 1 : closed.rows + 1)) {
+            continue;
+        }
+        for (int i = 0; i < E->numwindows; i++) {
+            editorWindow *win = &E->windows[i];
+            if (i == E->window) {
+                continue;
+            }
+            if (horizontal && win->left >= closed.left && win->left + win->cols <= closed.left + closed.cols) {
+                if (side == 0 && win->top == closed.top + closed.rows + 1) {
+                    win->top = closed.top;
+                } else if (!(side == 1 && win->top + win->rows + 1 == closed.top)) {
+                    continue;
+                }
+                win->rows += closed.rows + 1;
+            } else if (!horizontal && win->top >= closed.top && win->top + win->rows <= closed.top + closed.rows) {
+                if (side == 2 && win->left == closed.left + closed.cols + 1) {
+                    win->left = closed.left;
+                } else if (!(side == 3 && win->left + win->cols + 1 == closed.left)) {
+                    continue;
+                }
+                win->cols += closed.cols + 1;
+            } else {
+                continue;
+            }
+            win->redraw = true;
+            if (next < 0) {
+                next = i;
+            }
+        }
+    }
+    if (next < 0) {
+        return -1;
+    }
+
+    memmove(
+        &E->windows[E->window], &E->windows[E->window + 1],
+        sizeof(editorWindow) * (E->numwindows - E->window - 1)
+    );
+    E->numwindows--;
+    if (next > E->window) {
+        next--;
+    }
+    editorWindowLoad(E, next);
+    // 最後の 1 つになったら、画面を分けていない時に戻す
+    if (E->numwindows == 1) {
+        editorMemFree(E->windows);
+        E->windows = NULL;
+        E->numwindows = 0;
+        E->window = 0;
+    }
+    return 0;
+}
+
+/// 入力を受け取っているウィンドウ以外を閉じる関数
+void editorWindowOnly(editorConfig *E) {
+    if (E->numwindows == 0) {
+        return;
+    }
+    int rows, cols;
+    editorWindowArea(E, &rows, &cols);
+    editorMemFree(E->windows);
+    E->windows = NULL;
+    E->numwindows = 0;
+    E->window = 0;
+    E->screenrows = rows;
+    E->screencols = cols;
+}
+
+/// to 番目のウィンドウに入力を移す関数
+void editorWindowSelect(editorConfig *E, int to) {
+    editorWindowSave(E);
+    editorWindowLoad(E, to);
+}
+
+/// 入力を受け取っているウィンドウのカーソルとスクロールの位置を、E から windows に写す関数
+void editorWindowSave(editorConfig *E) {
+    if (E->numwindows == 0) {
+        return;
+    }
+    editorWindow *win = &E->windows[E->window];
+    win->cx = E->cx;
+    win->cy = E->cy;
+    win->rx = E->rx;
+    win->rowoff = E->rowoff;
+    win->coloff = E->coloff;
+}
+
+/// to 番目のウィンドウの大きさ、カーソルとスクロールの位置を E に写す関数
+// 他のウィンドウで行を消していることがあるので、カーソルは今の行の中に収める。
+void editorWindowLoad(editorConfig *E, int to) {
+    editorWindow *win = &E->windows[to];
+    E->window = to;
+    E->screenrows = win->rows;
+    E->screencols = win->cols;
+    E->cy = win->cy < E->numrows ? win->cy : E->numrows;
+    int rowlen = E->cy < E->numrows ? E->row[E->cy].size : 0;
+    E->cx = win->cx < rowlen ? win->cx : rowlen;
+    E->rx = win->rx;
+    E->rowoff = win->rowoff;
+    E->coloff = win->coloff;
+}
+
+/// 次のフレームで全てのウィンドウを書き直させる関数 (画面を他のバッファが上書きした時など)
+void editorWindowRedrawAll(editorConfig *E) {
+    for (int i = 0; i < E->numwindows; i++) {
+        E->windows[i].redraw = true;
+    }
+}
+
+/// 全てのウィンドウを合わせた、テキストを表示する大きさ (ステータスバーとメッセージバーを除く) を返す関数
+void editorWindowArea(editorConfig *E, int *rows, int *cols) {
+    if (E->numwindows == 0) {
+        *rows = E->screenrows;
+        *cols = E->screencols;
+        return;
+    }
+    *rows = 0;
+    *cols = 0;
+    for (int i = 0; i < E->numwindows; i++) {
+        editorWindow *win = &E->windows[i];
+        if (win->top + win->rows > *rows) {
+            *rows = win->top + win->rows;
+        }
+        if (win->left + win->cols > *cols) {
+            *cols = win->left + win->cols;
+        }
+    }
+}
+
+/// at 行目が、いずれかのウィンドウが表示している行から margin 行以内にあるかを返す関数
+// 絞り込みか折りたたみをしている時は、画面の先頭の行から最後の行までを表示している行とする。
+bool editorWindowNear(editorConfig *E, int at, int margin) {
+    for (int i = -1; i < E->numwindows; i++) {
+        if (i == E->window) {
+            continue;
+        }
+        int rowoff = i < 0 ? E->rowoff : E->windows[i].rowoff;
+        int rows = i < 0 ? E->screenrows : E->windows[i].rows;
+        int end = E->filter || E->folds ? editorViewRow(E, editorViewIndex(E, rowoff) + rows) : rowoff + rows;
+        if (at >= rowoff - margin && at < end + margin) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Filter */
+
+/// 実際の at 行目より前に表示する行の数 (at 行目を表示するなら、その表示している行の中での位置) を返す関数
+// 絞り込みも折りたたみもしていなければ at そのもの。最後の行の次 (numrows 行目) は常に表示している。
+// 絞り込んでいる時は、畳んだ範囲も表示する。
+int editorViewIndex(editorConfig *E, int at) {
+    if (E->filter) {
+        return editorFilterFind(E->filter, at);
+    }
+    if (E->folds) {
+        return at - editorFoldHiddenBefore(E, at);
+    }
+    return at;
+}
+
+/// 表示している行の index 番目が、実際の何行目かを返す関数 (表示している行を越えたら numrows)
+int editorViewRow(editorConfig *E, int index) {
+    if (E->filter) {
+        return index < E->filter->count ? E->filter->rows[index] : E->numrows;
+    }
+    if (E->folds) {
+        int at = editorFoldViewRow(E, index);
+        return at < E->numrows ? at : E->numrows;
+    }
+    return index;
+}
+
+/// 索引の中で、at 行目以降の最初の行の位置を返す関数 (二分探索)
+int editorFilterFind(editorFilter *filter, int at) {
+    int lo = 0;
+    int hi = filter->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (filter->rows[mid] < at) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool editorFilterMatch(editorFilter *filter, char *chars, int size) {
+    return memmem(chars, size, filter->pattern, filter->len) != NULL;
+}
+
+// editorFilterSet で 1 スレッドが受け持つ範囲と、その中で一致した行
+typedef struct {
+    editorConfig *E;
+    int from;
+    int to;
+    int *rows;
+    int count;
+} editorFilterChunk;
+
+/// chunk の範囲の行を調べて、パターンを含む行の番号を chunk->rows に並べるスレッド
+// 圧縮した行は、共有のキャッシュにあればそれを読み、無ければキャッシュを書き換えずにこのスレッドの領域に展開する。
+// (メインのスレッドは全てのスレッドを待っているので、その間は誰もキャッシュを書き換えない)
+void *editorFilterWorker(void *arg) {
+    editorFilterChunk *chunk = arg;
+    editorConfig *E = chunk->E;
+    traceSetThreadName("filter");
+    TRACE_BEGIN(span);
+    int cap = 0;
+    char *raw = NULL;
+    int rawcap = 0;
+    editorColdBlock *loaded = NULL;
+
+    for (int at = chunk->from; at < chunk->to; at++) {
+        erow *row = &E->row[at];
+        char *chars;
+        if (!row->cold) {
+            chars = editorRowChars(row);
+        } else if (row->text.cold_block->raw) {
+            chars = row->text.cold_block->raw + row->cold_offset;
+        } else {
+            editorColdBlock *block = row->text.cold_block;
+            if (block != loaded) {
+                if (block->raw_size > rawcap) {
+                    rawcap = block->raw_size;
+                    raw = realloc(raw, rawcap);
+                }
+                lzDecompress(block->data, block->size, raw, block->raw_size);
+                loaded = block;
+            }
+            chars = raw + row->cold_offset;
+        }
+        if (!editorFilterMatch(E->filter, chars, row->size)) {
+            continue;
+        }
+        if (chunk->count == cap) {
+            cap = cap ? cap * 2 : 1024;
+            chunk->rows = realloc(chunk->rows, sizeof(int) * cap);
+        }
+        chunk->rows[chunk->count++] = at;
+    }
+    free(raw);
+    TRACE_END("filter chunk", span);
+    return NULL;
+}
+
+/// pattern (len バイト) を含む行だけを表示するようにして、一致した行数を返す関数
+// 大きなバッファでは、行を分割して並列に探してから、範囲の順に索引へ繋ぐ。
+int editorFilterSet(editorConfig *E, char *pattern, int len) {
+    editorFilterClear(E);
+    TRACE_BEGIN(span);
+    editorFilter *filter = editorMalloc(MEM_SCRATCH, sizeof(editorFilter));
+    filter->pattern = editorMalloc(MEM_SCRATCH, len + 1);
+    memcpy(filter->pattern, pattern, len);
+    filter->pattern[len] = '\0';
+    filter->len = len;
+    filter->rows = NULL;
+    filter->count = 0;
+    filter->cap = 0;
+    filter->shown = -1;
+    E->filter = filter;
+
+    int nthreads = 1;
+    if (E->numrows >= KEDITOR_FILTER_PARALLEL_MIN_ROWS) {
+        nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+        if (nthreads < 1) {
+            nthreads = 1;
+        }
+        if (nthreads > KEDITOR_FILTER_MAX_THREADS) {
+            nthreads = KEDITOR_FILTER_MAX_THREADS;
+        }
+    }
+    editorFilterChunk chunks[KEDITOR_FILTER_MAX_THREADS];
+    pthread_t threads[KEDITOR_FILTER_MAX_THREADS];
+    bool started[KEDITOR_FILTER_MAX_THREADS];
+
+    int per_chunk = (E->numrows + nthreads - 1) / nthreads;
+    for (int t = 0; t < nthreads; t++) {
+        chunks[t].from = t * per_chunk < E->numrows ? t * per_chunk : E->numrows;
+        chunks[t].to = (t + 1) * per_chunk < E->numrows ? (t + 1) * per_chunk : E->numrows;
+        chunks[t].E = E;
+        chunks[t].rows = NULL;
+        chunks[t].count = 0;
+        // 1 スレッドで足りる時と、スレッドを作れなかった範囲はここで調べる
+        started[t] = nthreads > 1 && pthread_create(&threads[t], NULL, editorFilterWorker, &chunks[t]) == 0;
+        if (!started[t]) {
+            editorFilterWorker(&chunks[t]);
+        }
+    }
+
+    for (int t = 0; t < nthreads; t++) {
+        if (started[t]) {
+            pthread_join(threads[t], NULL);
+        }
+        filter->count += chunks[t].count;
+    }
+    filter->cap = filter->count > 0 ? filter->count : 1;
+    filter->rows = editorMalloc(MEM_ROWS, sizeof(int) * filter->cap);
+    int count = 0;
+    for (int t = 0; t < nthreads; t++) {
+        if (chunks[t].count > 0) {
+            memcpy(&filter->rows[count], chunks[t].rows, sizeof(int) * chunks[t].count);
+            count += chunks[t].count;
+        }
+        free(chunks[t].rows);
+    }
+
+    editorDamage(E, 0, INT_MAX);
+    TRACE_END("filter", span);
+    return filter->count;
+}
+
+/// 絞り込みをやめて、全ての行を表示する関数
+void editorFilterClear(editorConfig *E) {
+    if (E->filter == NULL) {
+        return;
+    }
+    editorMemFree(E->filter->pattern);
+    editorMemFree(E->filter->rows);
+    editorMemFree(E->filter);
+    E->filter = NULL;
+    editorDamage(E, 0, INT_MAX);
+}
+
+/// at 行目から del 行を消して ins 行を入れた時に、索引を直す関数
+// 消した行を索引から除き、後ろの行の番号をずらす。入れた行は、内容を設定する時に editorFilterUpdateRow が調べる。
+void editorFilterSplice(editorConfig *E, int at, int del, int ins) {
+    editorFilter *filter = E->filter;
+    if (filter == NULL) {
+        return;
+    }
+    int from = editorFilterFind(filter, at);
+    int to = editorFilterFind(filter, at + del);
+    memmove(&filter->rows[from], &filter->rows[to], sizeof(int) * (filter->count - to));
+    filter->count -= to - from;
+    for (int i = from; i < filter->count; i++) {
+        filter->rows[i] += ins - del;
+    }
+    if (filter->shown >= at + del) {
+        filter->shown += ins - del;
+    } else if (filter->shown >= at) {
+        filter->shown = -1;
+    }
+}
+
+/// 内容が変わった at 行目を調べ直して、索引に加えるか除く関数
+// カーソルのある行は、編集している途中でパターンを含まなくなっても表示したままにする。
+void editorFilterUpdateRow(editorConfig *E, int at) {
+    editorFilter *filter = E->filter;
+    erow *row = &E->row[at];
+    bool match = editorFilterMatch(filter, editorRowChars(row), row->size);
+    int i = editorFilterFind(filter, at);
+    bool listed = i < filter->count && filter->rows[i] == at;
+    if (match && !listed) {
+        editorFilterShow(E, at);
+    } else if (!match && listed && at != E->cy) {
+        memmove(&filter->rows[i], &filter->rows[i + 1], sizeof(int) * (filter->count - i - 1));
+        filter->count--;
+    }
+}
+
+/// at 行目を (パターンを含んでいなくても) 表示する行に加える関数
+void editorFilterShow(editorConfig *E, int at) {
+    editorFilter *filter = E->filter;
+    int i = editorFilterFind(filter, at);
+    if (i < filter->count && filter->rows[i] == at) {
+        return;
+    }
+    if (filter->count == filter->cap) {
+        filter->cap *= 2;
+        filter->rows = editorRealloc(MEM_ROWS, filter->rows, sizeof(int) * filter->cap);
+    }
+    memmove(&filter->rows[i + 1], &filter->rows[i], sizeof(int) * (filter->count - i));
+    filter->rows[i] = at;
+    filter->count++;
+    editorDamage(E, at, at + 1);
+}
+
+/// カーソルのある行を表示する行に加え、カーソルが離れた行はパターンを含まなければ索引から除く関数
+void editorFilterCursor(editorConfig *E) {
+    editorFilter *filter = E->filter;
+    int at = filter->shown;
+    if (at >= 0 && at != E->cy && at < E->numrows &&
+        !editorFilterMatch(filter, editorRowChars(&E->row[at]), E->row[at].size)) {
+        int i = editorFilterFind(filter, at);
+        if (i < filter->count && filter->rows[i] == at) {
+            memmove(&filter->rows[i], &filter->rows[i + 1], sizeof(int) * (filter->count - i - 1));
+            filter->count--;
+            editorDamage(E, at, INT_MAX);
+        }
+    }
+    filter->shown = -1;
+    if (E->cy < E->numrows) {
+        editorFilterShow(E, E->cy);
+        filter->shown = E->cy;
+    }
+}
+
+/* Folding */
+
+/// Ctrl-F の次に押したキー c に対応する、畳む操作をする関数
+void editorFoldCommand(editorConfig *E, int c) {
+    int start, end;
+    switch (c) {
+        // カーソルのある行から始まるブロック (無ければカーソルを含むブロック) を畳む
+        case 'c':
+            if (editorFoldDetect(E, E->cy, &start, &end) < 0) {
+                editorSetStatusMessage(E, "No block to fold here");
+                break;
+            }
+            editorFoldAdd(E, start, end);
+            E->cy = start;
+            break;
+        case 'o':
+            if (!editorFoldOpen(E, E->cy)) {
+                editorSetStatusMessage(E, "No fold here");
+            }
+            break;
+        case 'a':
+            if (!editorFoldOpen(E, E->cy)) {
+                editorFoldCommand(E, 'c');
+            }
+            break;
+        // 始めの行を覚えておき、次にカーソルのある行までを畳む
+        case 'm':
+            E->fold_mark = E->cy;
+            editorSetStatusMessage(E, "Fold from line %d: move and press Ctrl-F f", E->cy + 1);
+            break;
+        case 'f':
+            if (E->fold_mark < 0 || E->fold_mark == E->cy || E->cy >= E->numrows) {
+                editorSetStatusMessage(E, "Set the first line with Ctrl-F m");
+                break;
+            }
+            start = E->fold_mark < E->cy ? E->fold_mark : E->cy;
+            end = E->fold_mark < E->cy ? E->cy : E->fold_mark;
+            editorFoldAdd(E, start, end < E->numrows ? end : E->numrows - 1);
+            E->cy = start;
+            E->fold_mark = -1;
+            break;
+        case 'R':
+            editorFoldOpenAll(E);
+            break;
+    }
+}
+
+/// 行頭の空白の幅を返す関数 (空白だけの行は -1)
+int editorFoldIndent(erow *row) {
+    char *chars = editorRowChars(row);
+    int width = 0;
+    for (int i = 0; i < row->size; i++) {
+        if (chars[i] == ' ') {
+            width++;
+        } else if (chars[i] == '\t') {
+            width += KEDITOR_TAB_STOP - (width % KEDITOR_TAB_STOP);
+        } else {
+            return width;
+        }
+    }
+    return -1;
+}
+
+/// 行の中の括弧 ({ と }) の深さの変化を返す関数 (文字列と、行コメントの後ろは数えない)
+// opened には、行の途中で閉じずに残った { があるかを入れる。
+int editorFoldBraces(editorConfig *E, erow *row, bool *opened) {
+    char *chars = editorRowChars(row);
+    char *comment = E->syntax ? E->syntax->singleline_comment_start : NULL;
+    int comment_len = comment ? strlen(comment) : 0;
+    int depth = 0;
+    int lowest = 0;
+    char quote = 0;
+    for (int i = 0; i < row->size; i++) {
+        char c = chars[i];
+        if (quote) {
+            if (c == '\\') {
+                i++;
+            } else if (c == quote) {
+                quote = 0;
+            }
+            continue;
+        }
+        if (comment_len && !strncmp(&chars[i], comment, comment_len)) {
+            break;
+        }
+        if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == '{') {
+            depth++;
+        } else if (c == '}') {
+            depth--;
+            lowest = depth < lowest ? depth : lowest;
+        }
+    }
+    *opened = depth > lowest;
+    return depth;
+}
+
+/// at 行目から始まるブロックの範囲を求める関数 (見出しの行と、隠す最後の行)
+// 行が { を開いていれば対応する } の手前の行まで、そうでなければ字下げが深い行が続く所までをブロックとする。
+// at 行目からブロックが始まらない時は、at 行目を含むブロックの見出しを上に探す。見つからなければ -1 を返す。
+int editorFoldDetect(editorConfig *E, int at, int *start, int *end) {
+    // ブロックはどこまで続くか分からないので、読み込んでいる途中なら最後まで読み込む
+    editorLoadFinish(E);
+    for (int tries = 0; tries < 2 && at >= 0 && at < E->numrows; tries++) {
+        bool opened;
+        if (editorFoldBraces(E, &E->row[at], &opened) > 0 || opened) {
+            int depth = 0;
+            for (int i = at; i < E->numrows; i++) {
+                depth += editorFoldBraces(E, &E->row[i], &opened);
+                if (depth <= 0 && i > at) {
+                    if (i - 1 > at) {
+                        *start = at;
+                        *end = i - 1;
+                        return 0;
+                    }
+                    break;
+                }
+            }
+        }
+
+        int indent = editorFoldIndent(&E->row[at]);
+        int last = at;
+        for (int i = at + 1; indent >= 0 && i < E->numrows; i++) {
+            int width = editorFoldIndent(&E->row[i]);
+            if (width >= 0 && width <= indent) {
+                break;
+            }
+            // 空白だけの行はブロックの途中なら含め、最後なら含めない
+            if (width > indent) {
+                last = i;
+            }
+        }
+        if (last > at) {
+            *start = at;
+            *end = last;
+            return 0;
+        }
+
+        // 字下げが浅い行を上に探して、その行から始まるブロックを調べる
+        int width = editorFoldIndent(&E->row[at]);
+        int up = at - 1;
+        while (up >= 0) {
+            int w = editorFoldIndent(&E->row[up]);
+            if (w >= 0 && (width < 0 || w < width)) {
+                break;
+            }
+            up--;
+        }
+        at = up;
+    }
+    return -1;
+}
+
+/// 部分木 node の全ての範囲を delta 行ずらす関数 (子には辿る時に伝える)
+void editorFoldShift(editorFold *node, int delta) {
+    if (node) {
+        node->start += delta;
+        node->end += delta;
+        node->shift += delta;
+    }
+}
+
+void editorFoldPush(editorFold *node) {
+    if (node->shift) {
+        editorFoldShift(node->left, node->shift);
+        editorFoldShift(node->right, node->shift);
+        node->shift = 0;
+    }
+}
+
+void editorFoldPull(editorFold *node) {
+    node->hidden = node->end - node->start;
+    if (node->left) {
+        node->hidden += node->left->hidden;
+    }
+    if (node->right) {
+        node->hidden += node->right->hidden;
+    }
+}
+
+/// 木 node を、start が key より前の範囲 (*left) と key 以降の範囲 (*right) に分ける関数
+void editorFoldSplit(editorFold *node, int key, editorFold **left, editorFold **right) {
+    if (node == NULL) {
+        *left = NULL;
+        *right = NULL;
+        return;
+    }
+    editorFoldPush(node);
+    if (node->start < key) {
+        editorFoldSplit(node->right, key, &node->right, right);
+        *left = node;
+    } else {
+        editorFoldSplit(node->left, key, left, &node->left);
+        *right = node;
+    }
+    editorFoldPull(node);
+}
+
+/// 全ての範囲が right より前にある木 left と right を繋ぐ関数
+editorFold *editorFoldMerge(editorFold *left, editorFold *right) {
+    if (left == NULL || right == NULL) {
+        return left ? left : right;
+    }
+    if (left->priority > right->priority) {
+        editorFoldPush(left);
+        left->right = editorFoldMerge(left->right, right);
+        editorFoldPull(left);
+        return left;
+    }
+    editorFoldPush(right);
+    right->left = editorFoldMerge(left, right->left);
+    editorFoldPull(right);
+    return right;
+}
+
+void editorFoldFreeTree(editorFold *node) {
+    if (node) {
+        editorFoldFreeTree(node->left);
+        editorFoldFreeTree(node->right);
+        editorMemFree(node);
+    }
+}
+
+/// 木の最後 (start が最も大きい) の範囲を返す関数 (途中の shift は伝えておく)
+editorFold *editorFoldLast(editorFold *node) {
+    while (node) {
+        editorFoldPush(node);
+        if (node->right == NULL) {
+            break;
+        }
+        node = node->right;
+    }
+    return node;
+}
+
+/// 木の最後の範囲の end を end に変える関数 (部分木の隠している行数も直す)
+void editorFoldSetLastEnd(editorFold *node, int end) {
+    editorFoldPush(node);
+    if (node->right) {
+        editorFoldSetLastEnd(node->right, end);
+    } else {
+        node->end = end;
+    }
+    editorFoldPull(node);
+}
+
+/// start 行目を見出しにして、end 行目までを畳む関数
+// 重なる範囲や中に含まれる範囲は、1 つにまとめる (内側の範囲は覚えておかない)。
+void editorFoldAdd(editorConfig *E, int start, int end) {
+    static unsigned int seed = 2463534242u;
+    editorFold *left, *middle, *right;
+    editorFoldSplit(E->folds, start, &left, &right);
+    // 前の範囲が start 行目まで隠していれば、その見出しから畳む
+    editorFold *last = editorFoldLast(left);
+    if (last && last->end >= start) {
+        start = last->start;
+        editorFoldSplit(left, start, &left, &middle);
+        end = middle->end > end ? middle->end : end;
+        editorFoldFreeTree(middle);
+    }
+    editorFoldSplit(right, end + 1, &middle, &right);
+    last = editorFoldLast(middle);
+    if (last && last->end > end) {
+        end = last->end;
+    }
+    editorFoldFreeTree(middle);
+
+    editorFold *node = editorMalloc(MEM_ROWS, sizeof(editorFold));
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    node->left = NULL;
+    node->right = NULL;
+    node->priority = seed;
+    node->start = start;
+    node->end = end;
+    node->shift = 0;
+    editorFoldPull(node);
+    E->folds = editorFoldMerge(editorFoldMerge(left, node), right);
+    editorDamage(E, start, INT_MAX);
+}
+
+/// at 行目を見出しにしている (か、隠している) 範囲を開く関数 (開いた範囲が無ければ false)
+bool editorFoldOpen(editorConfig *E, int at) {
+    editorFold *node = editorFoldFind(E, at);
+    if (node == NULL) {
+        return false;
+    }
+    int start = node->start;
+    editorFold *left, *middle, *right;
+    editorFoldSplit(E->folds, start, &left, &right);
+    editorFoldSplit(right, start + 1, &middle, &right);
+    editorFoldFreeTree(middle);
+    E->folds = editorFoldMerge(left, right);
+    editorDamage(E, start, INT_MAX);
+    return true;
+}
+
+void editorFoldOpenAll(editorConfig *E) {
+    editorFoldFreeTree(E->folds);
+    E->folds = NULL;
+    editorDamage(E, 0, INT_MAX);
+}
+
+/// at 行目を含む範囲 (見出しの行か、隠している行) を返す関数 (無ければ NULL)
+editorFold *editorFoldFind(editorConfig *E, int at) {
+    editorFold *node = E->folds;
+    while (node) {
+        editorFoldPush(node);
+        if (at < node->start) {
+            node = node->left;
+        } else if (at > node->end) {
+            node = node->right;
+        } else {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+/// at 行目より前で隠している行数を返す関数
+int editorFoldHiddenBefore(editorConfig *E, int at) {
+    int hidden = 0;
+    editorFold *node = E->folds;
+    while (node) {
+        editorFoldPush(node);
+        if (at <= node->start) {
+            node = node->left;
+            continue;
+        }
+        hidden += node->left ? node->left->hidden : 0;
+        if (at <= node->end) {
+            return hidden + at - node->start - 1;
+        }
+        hidden += node->end - node->start;
+        node = node->right;
+    }
+    return hidden;
+}
+
+/// 表示している行の index 番目が、実際の何行目かを返す関数
+// 部分木を辿りながら、見出しの行までに表示している行数と index を比べて左右に進む。
+int editorFoldViewRow(editorConfig *E, int index) {
+    int hidden = 0;
+    editorFold *node = E->folds;
+    while (node) {
+        editorFoldPush(node);
+        int before = hidden + (node->left ? node->left->hidden : 0);
+        // 見出しの行 (start 行目) までに表示している行数
+        if (index <= node->start - before) {
+            node = node->left;
+            continue;
+        }
+        hidden = before + node->end - node->start;
+        node = node->right;
+    }
+    return index + hidden;
+}
+
+/// at 行目から del 行を消して ins 行を入れた時に、畳んだ範囲を直す関数
+// 見出しを消した範囲は開き、後ろの範囲は木を分けて根の shift でまとめてずらす。
+// 範囲の途中で行を消すか入れた時は、その範囲の end だけを直す (重ならないので、そうなるのは 1 つだけ)。
+void editorFoldSplice(editorConfig *E, int at, int del, int ins) {
+    if (E->fold_mark >= at + del) {
+        E->fold_mark += ins - del;
+    } else if (E->fold_mark >= at) {
+        E->fold_mark = -1;
+    }
+    if (E->folds == NULL) {
+        return;
+    }
+    editorFold *left, *middle, *right;
+    editorFoldSplit(E->folds, at, &left, &right);
+    editorFoldSplit(right, at + del, &middle, &right);
+    editorFoldFreeTree(middle);
+    editorFoldShift(right, ins - del);
+
+    editorFold *last = editorFoldLast(left);
+    if (last && last->end >= at) {
+        int end = last->end;
+        // 消した行のうち、範囲の中にあった分を縮め、入れた行は範囲の中に含める
+        end -= (end < at + del - 1 ? end : at + del - 1) - at + 1;
+        end += ins;
+        editorDamage(E, last->start, INT_MAX);
+        if (end > last->start) {
+            editorFoldSetLastEnd(left, end);
+        } else {
+            editorFoldSplit(left, last->start, &left, &middle);
+            editorFoldFreeTree(middle);
+        }
+    }
+    E->folds = editorFoldMerge(left, right);
+}
+
+/* Anchors */
+
+/// Ctrl-K の次に押したキー c に対応する、目印の操作をする関数 (pending は待っていたキー)
+void editorAnchorCommand(editorConfig *E, int pending, int c) {
+    editorAnchor *node;
+    if (pending == 'm' || pending == '\'') {
+        if (c < 'a' || c > 'z') {
+            editorSetStatusMessage(E, "Mark names are a-z");
+            return;
+        }
+        if (pending == '\'') {
+            if (E->marks[c - 'a'] == NULL) {
+                editorSetStatusMessage(E, "Mark %c is not set", c);
+                return;
+            }
+            editorAnchorJump(E, E->marks[c - 'a']);
+            return;
+        }
+        if (E->cy >= E->numrows) {
+            return;
+        }
+        if (E->marks[c - 'a']) {
+            editorAnchorRemove(E, ANCHOR_MARK, E->marks[c - 'a']);
+        }
+        editorAnchorAdd(E, ANCHOR_MARK, E->cy, E->cx, c);
+        editorSetStatusMessage(E, "Mark %c set at line %d", c, E->cy + 1);
+        return;
+    }
+
+    switch (c) {
+        // マークの名前を待つ
+        case 'm':
+            E->mark_key = 'm';
+            editorSetStatusMessage(E, "Set mark (a-z):");
+            break;
+        case '\'':
+            E->mark_key = '\'';
+            editorSetStatusMessage(E, "Jump to mark (a-z):");
+            break;
+        // カーソルのある行のブックマークを付け外しする
+        case 'b':
+            {
+                editorAnchor *left, *middle, *right;
+                if (E->cy >= E->numrows) {
+                    break;
+                }
+                editorAnchorSplit(E->anchors[ANCHOR_BOOKMARK], E->cy, 0, &left, &right);
+                editorAnchorSplit(right, E->cy + 1, 0, &middle, &right);
+                editorAnchorSetRoot(E, ANCHOR_BOOKMARK, editorAnchorMerge(left, right));
+                if (middle) {
+                    editorAnchorFreeTree(E, middle);
+                    editorSetStatusMessage(E, "Bookmark removed from line %d", E->cy + 1);
+                } else {
+                    editorAnchorAdd(E, ANCHOR_BOOKMARK, E->cy, E->cx, 0);
+                    editorSetStatusMessage(E, "Bookmark set at line %d", E->cy + 1);
+                }
+            }
+            break;
+        // 次の (前の) ブックマークかマークに移る (端まで行ったら反対の端に戻る)
+        case 'n':
+        case 'p':
+        case ']':
+        case '[':
+            node = editorAnchorNext(E, c == 'n' || c == 'p' ? ANCHOR_BOOKMARK : ANCHOR_MARK,
+                                    E->cy, E->cx, c == 'n' || c == ']');
+            if (node == NULL) {
+                editorSetStatusMessage(E, c == 'n' || c == 'p' ? "No bookmarks" : "No marks");
+                break;
+            }
+            editorAnchorJump(E, node);
+            break;
+        case 'c':
+            editorAnchorClear(E, ANCHOR_BOOKMARK);
+            editorSetStatusMessage(E, "Bookmarks cleared");
+            break;
+    }
+}
+
+/// (row, col) が (key_row, key_col) より前にあるかを返す関数
+bool editorAnchorLess(int row, int col, int key_row, int key_col) {
+    return row < key_row || (row == key_row && col < key_col);
+}
+
+/// 部分木 node の全ての目印を delta 行ずらす関数 (子には辿る時に伝える)
+void editorAnchorShift(editorAnchor *node, int delta) {
+    if (node) {
+        node->row += delta;
+        node->shift += delta;
+    }
+}
+
+void editorAnchorPush(editorAnchor *node) {
+    if (node->shift) {
+        editorAnchorShift(node->left, node->shift);
+        editorAnchorShift(node->right, node->shift);
+        node->shift = 0;
+    }
+}
+
+/// 子の親を node に付け直す関数 (子を付け替えた後に呼ぶ)
+void editorAnchorPull(editorAnchor *node) {
+    if (node->left) {
+        node->left->parent = node;
+    }
+    if (node->right) {
+        node->right->parent = node;
+    }
+}
+
+/// 木 node を、(row, col) より前の目印 (*left) と、それ以降の目印 (*right) に分ける関数
+void editorAnchorSplit(editorAnchor *node, int row, int col, editorAnchor **left, editorAnchor **right) {
+    if (node == NULL) {
+        *left = NULL;
+        *right = NULL;
+        return;
+    }
+    editorAnchorPush(node);
+    if (editorAnchorLess(node->row, node->col, row, col)) {
+        editorAnchorSplit(node->right, row, col, &node->right, right);
+        *left = node;
+    } else {
+        editorAnchorSplit(node->left, row, col, left, &node->left);
+        *right = node;
+    }
+    editorAnchorPull(node);
+}
+
+/// 全ての目印が right より前にある木 left と right を繋ぐ関数
+editorAnchor *editorAnchorMerge(editorAnchor *left, editorAnchor *right) {
+    if (left == NULL || right == NULL) {
+        return left ? left : right;
+    }
+    if (left->priority > right->priority) {
+        editorAnchorPush(left);
+        left->right = editorAnchorMerge(left->right, right);
+        editorAnchorPull(left);
+        return left;
+    }
+    editorAnchorPush(right);
+    right->left = editorAnchorMerge(left, right->left);
+    editorAnchorPull(right);
+    return right;
+}
+
+/// 木 node の目印を全て解放する関数 (名前を付けたマークは、名前からも外す)
+void editorAnchorFreeTree(editorConfig *E, editorAnchor *node) {
+    if (node) {
+        editorAnchorFreeTree(E, node->left);
+        editorAnchorFreeTree(E, node->right);
+        if (node->name) {
+            E->marks[node->name - 'a'] = NULL;
+        }
+        editorMemFree(node);
+    }
+}
+
+void editorAnchorSetRoot(editorConfig *E, int kind, editorAnchor *root) {
+    if (root) {
+        root->parent = NULL;
+    }
+    E->anchors[kind] = root;
+}
+
+/// row 行目の col 文字目に kind の目印を付ける関数 (name はマークの名前か 0)
+editorAnchor *editorAnchorAdd(editorConfig *E, int kind, int row, int col, char name) {
+    static unsigned int seed = 88675123u;
+    editorAnchor *node = editorMalloc(MEM_ROWS, sizeof(editorAnchor));
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    node->left = NULL;
+    node->right = NULL;
+    node->parent = NULL;
+    node->priority = seed;
+    node->row = row;
+    node->col = col;
+    node->shift = 0;
+    node->name = name;
+    if (name) {
+        E->marks[name - 'a'] = node;
+    }
+
+    // 同じ位置の目印の後ろに入れる
+    editorAnchor *left, *right;
+    editorAnchorSplit(E->anchors[kind], row, col + 1, &left, &right);
+    editorAnchorSetRoot(E, kind, editorAnchorMerge(editorAnchorMerge(left, node), right));
+    return node;
+}
+
+/// 木 node から目印 target を外した木を返す関数 (同じ位置の目印だけの小さな木に使う)
+editorAnchor *editorAnchorDetach(editorAnchor *node, editorAnchor *target) {
+    if (node == NULL) {
+        return NULL;
+    }
+    editorAnchorPush(node);
+    if (node == target) {
+        return editorAnchorMerge(node->left, node->right);
+    }
+    node->left = editorAnchorDetach(node->left, target);
+    node->right = editorAnchorDetach(node->right, target);
+    editorAnchorPull(node);
+    return node;
+}
+
+/// kind の木から目印 node を外して解放する関数
+void editorAnchorRemove(editorConfig *E, int kind, editorAnchor *node) {
+    int row, col;
+    editorAnchorPosition(node, &row, &col);
+    editorAnchor *left, *middle, *right;
+    editorAnchorSplit(E->anchors[kind], row, col, &left, &right);
+    editorAnchorSplit(right, row, col + 1, &middle, &right);
+    middle = editorAnchorDetach(middle, node);
+    node->left = NULL;
+    node->right = NULL;
+    editorAnchorFreeTree(E, node);
+    editorAnchorSetRoot(E, kind, editorAnchorMerge(editorAnchorMerge(left, middle), right));
+}
+
+void editorAnchorClear(editorConfig *E, int kind) {
+    editorAnchorFreeTree(E, E->anchors[kind]);
+    E->anchors[kind] = NULL;
+}
+
+/// 目印 node の今の位置を返す関数 (親を辿って、まだ伝えていない shift を足す)
+void editorAnchorPosition(editorAnchor *node, int *row, int *col) {
+    *row = node->row;
+    *col = node->col;
+    for (editorAnchor *p = node->parent; p; p = p->parent) {
+        *row += p->shift;
+    }
+}
+
+/// (row, col) の次 (forward でなければ前) にある kind の目印を返す関数 (無ければ反対の端の目印)
+editorAnchor *editorAnchorNext(editorConfig *E, int kind, int row, int col, bool forward) {
+    editorAnchor *found = NULL;
+    editorAnchor *node = E->anchors[kind];
+    while (node) {
+        editorAnchorPush(node);
+        if (forward ? editorAnchorLess(row, col, node->row, node->col)
+                    : editorAnchorLess(node->row, node->col, row, col)) {
+            found = node;
+            node = forward ? node->left : node->right;
+        } else {
+            node = forward ? node->right : node->left;
+        }
+    }
+    if (found == NULL) {
+        node = E->anchors[kind];
+        while (node) {
+            editorAnchorPush(node);
+            found = node;
+            node = forward ? node->left : node->right;
+        }
+    }
+    return found;
+}
+
+/// 目印 node の位置にカーソルを移す関数
+void editorAnchorJump(editorConfig *E, editorAnchor *node) {
+    int row, col;
+    editorAnchorPosition(node, &row, &col);
+    if (row >= E->numrows) {
+        return;
+    }
+    E->cy = row;
+    // 目印を付けた後に行が置き換えられて (読み込み直しで) 短くなっていれば、行末に移す
+    E->cx = col < E->row[row].size ? col : E->row[row].size;
+    editorRevealCursor(E);
+}
+
+/// 同じ行にある目印だけの木 node の位置を付け直す関数
+// base 文字目から del 文字を ins 文字に置き換えた後の位置を、row 行目の to 文字目を基準にして求める。
+// 置き換えた文字の中にあった目印は to 文字目に移す。
+void editorAnchorRebase(editorAnchor *node, int row, int base, int del, int ins, int to) {
+    if (node == NULL) {
+        return;
+    }
+    editorAnchorRebase(node->left, row, base, del, ins, to);
+    editorAnchorRebase(node->right, row, base, del, ins, to);
+    node->row = row;
+    node->col = node->col < base + del ? to : to + ins + node->col - base - del;
+    node->shift = 0;
+}
+
+/// at 行目から del 行を消して ins 行を入れた時に、目印の位置を直す関数
+// 消した行にあった目印は外し、後ろの目印は木を分けて根の shift でまとめてずらす。
+void editorAnchorSplice(editorConfig *E, int at, int del, int ins) {
+    for (int kind = 0; kind < ANCHOR_KINDS; kind++) {
+        if (E->anchors[kind] == NULL) {
+            continue;
+        }
+        editorAnchor *left, *middle, *right;
+        editorAnchorSplit(E->anchors[kind], at, 0, &left, &right);
+        editorAnchorSplit(right, at + del, 0, &middle, &right);
+        editorAnchorFreeTree(E, middle);
+        editorAnchorShift(right, ins - del);
+        editorAnchorSetRoot(E, kind, editorAnchorMerge(left, right));
+    }
+}
+
+/// at 行目の col 文字目から del 文字を消して ins 文字を入れた時に、その行の目印の位置を直す関数
+void editorAnchorSpliceCols(editorConfig *E, int at, int col, int del, int ins) {
+    for (int kind = 0; kind < ANCHOR_KINDS; kind++) {
+        if (E->anchors[kind] == NULL) {
+            continue;
+        }
+        editorAnchor *left, *middle, *right;
+        editorAnchorSplit(E->anchors[kind], at, col, &left, &right);
+        editorAnchorSplit(right, at + 1, 0, &middle, &right);
+        editorAnchorRebase(middle, at, col, del, ins, col);
+        editorAnchorSetRoot(E, kind, editorAnchorMerge(editorAnchorMerge(left, middle), right));
+    }
+}
+
+/// row 行目の col 文字目以降にある目印を、to_row 行目の to_col 文字目以降に移す関数 (改行と行の連結)
+// 移した先は row 行目の前後の目印の間に収まる (改行で作った行と、連結する行の末尾) ので、木の並びは変わらない。
+void editorAnchorMove(editorConfig *E, int row, int col, int to_row, int to_col) {
+    for (int kind = 0; kind < ANCHOR_KINDS; kind++) {
+        if (E->anchors[kind] == NULL) {
+            continue;
+        }
+        editorAnchor *left, *middle, *right;
+        editorAnchorSplit(E->anchors[kind], row, col, &left, &right);
+        editorAnchorSplit(right, row + 1, 0, &middle, &right);
+        editorAnchorRebase(middle, to_row, col, 0, 0, to_col);
+        editorAnchorSetRoot(E, kind, editorAnchorMerge(editorAnchorMerge(left, middle), right));
+    }
+}
+
+/* File I/O */
+
+char *editorRowsToString(editorConfig *E, int *buflen) {
+    int total_length = 0;
+    int i = 0;
+    for (i = 0; i < E->numrows; i++) {
+        total_length += (E->row[i].size + 1);
+    }
+    *buflen = total_length;
+
+    char *buf = editorMalloc(MEM_SCRATCH, sizeof(char) * total_length);
+    char *head = buf;
+    for (i = 0; i < E->numrows; i++) {
+        memcpy(head, editorRowChars(&E->row[i]), E->row[i].size);
+        head += E->row[i].size;
+        *head++ = '\n';
+    }
+
+    return buf;
+}
+
+/// 開いたファイル fd の状態 (st は fd を fstat したもの) を stamp に写す関数
+void editorFileStampSet(editorFileStamp *stamp, int fd, struct stat *st) {
+    stamp->valid = true;
+    stamp->size = st->st_size;
+    stamp->mtime = st->st_mtim.tv_sec;
+    stamp->mtime_nsec = st->st_mtim.tv_nsec;
+    stamp->ino = st->st_ino;
+    if (sidecarSampleHash(fd, st->st_size, &stamp->sample) < 0) {
+        stamp->sample = 0;
+    }
+}
+
+/// 今の E->filename の状態を、読み込んだ (保存した) 時の状態として覚える関数
+void editorStampFile(editorConfig *E) {
+    E->file_stamp.valid = false;
+    int fd = E->filename ? open(E->filename, O_RDONLY) : -1;
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        editorFileStampSet(&E->file_stamp, fd, &st);
+    }
+    close(fd);
+}
+
+/// 読み込んだ (保存した) 後に、他のプロセスがファイルを書き換えたかを返す関数
+// 大きさ、更新時刻、inode (別のファイルに置き換えて保存された時) と、所々を読んだ内容のハッシュを比べる。
+// ハッシュは、大きさが同じまま更新時刻の分解能より短い間に書き換えられた時のため。
+// 状態を覚えていない時や、ファイルが消えている時は false を返す。
+bool editorFileChanged(editorConfig *E) {
+    if (!E->file_stamp.valid || E->filename == NULL) {
+        return false;
+    }
+    int fd = open(E->filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    bool changed = false;
+    if (fstat(fd, &st) == 0) {
+        editorFileStamp now;
+        editorFileStampSet(&now, fd, &st);
+        changed = now.size != E->file_stamp.size || now.mtime != E->file_stamp.mtime ||
+                  now.mtime_nsec != E->file_stamp.mtime_nsec || now.ino != E->file_stamp.ino ||
+                  now.sample != E->file_stamp.sample;
+    }
+    close(fd);
+    return changed;
+}
+
+/// E->filename にバッファの内容を書き込む関数
+// ファイル名が無い時にどうするか (プロンプトを出すかなど) は呼び出し側が決める。
+int editorSave(editorConfig *E) {
+    if (E->filename == NULL) {
+        editorSetStatusMessage(E, "Save aborted");
+        return -1;
+    }
+    // 読み込んでいる途中なら、残りを読み込んでから書き込む
+    editorLoadFinish(E);
+
+    int len;
+    char *buf = editorRowsToString(E, &len);
+
+    int fd = open(E->filename, O_RDWR | O_CREAT, 0644);
+    if (fd != -1) {
+        if (ftruncate(fd, len) != -1) {
+            if (write(fd, buf, len) == len) {
+                E->dirty = 0;
+                // 全ての行を改行付きで書いたので、ファイルの末尾まで読み込んだのと同じになる
+                E->file_offset = len;
+                E->file_tail = -1;
+                struct stat st;
+                if (fstat(fd, &st) == 0) {
+                    editorFileStampSet(&E->file_stamp, fd, &st);
+                }
+                close(fd);
+                editorMemFree(buf);
+                editorSetStatusMessage(E, "%d bytes written to disk", len);
+                return 0;
+            }
+        }
+        close(fd);
+    }
+    editorMemFree(buf);
+    editorSetStatusMessage(E, "Can't save! I/O error: %s", strerror(errno));
+    return -1;
+}
+
+/// 開いているファイルの末尾に追記された分を読み込んで、追加した行数を返す関数
+// 前回読み込んだ所 (E->file_offset) から後ろだけを読み、行はバッファの末尾に editorAppendRow で追加する。
+// 最後の改行の無い部分は仮の行として追加し、次に読み込んだ時に置き換える (仮の行の下に行を足していれば、仮の行の位置に入れる)。
+// 仮の行が編集されていれば置き換えずに普通の行として残し、続きを読んだ行は別に追加する。
+// ファイルが短くなっていれば (ログのローテーションなど)、先頭から読み直した分を末尾に追加する。
+// 一度に読むのは KEDITOR_FOLLOW_READ_BYTES 程度までで、続きが残れば E->follow_pending を立てる。
+// 読み込んだ行は編集ではないので E->dirty は変えない。
+int editorFollow(editorConfig *E) {
+    if (E->filename == NULL) {
+        return 0;
+    }
+    int fd = open(E->filename, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return 0;
+    }
+    E->follow_pending = false;
+    if (st.st_size == E->file_offset) {
+        editorFileStampSet(&E->file_stamp, fd, &st);
+        close(fd);
+        return 0;
+    }
+    int dirty = E->dirty;
+    if (st.st_size < E->file_offset) {
+        // 前のファイルの仮の行は、読み直す前に消しておく
+        if (E->file_tail >= 0) {
+            editorDeleteRow(E, E->file_tail);
+            E->file_tail = -1;
+        }
+        E->file_offset = 0;
+        editorSetStatusMessage(E, "%s was truncated", E->filename);
+    }
+    TRACE_BEGIN(span);
+
+    // 一度に読むのは KEDITOR_FOLLOW_READ_BYTES 程度までだが、1 行も終わらない時は行の終わりまで読む
+    long avail = st.st_size - E->file_offset;
+    long cap = avail < KEDITOR_FOLLOW_READ_BYTES ? avail : KEDITOR_FOLLOW_READ_BYTES;
+    char *buf = editorMalloc(MEM_SCRATCH, cap);
+    long len = 0;
+    while (len < avail) {
+        if (len == cap) {
+            if (memchr(buf, '\n', len)) {
+                break;
+            }
+            cap = cap * 2 < avail ? cap * 2 : avail;
+            buf = editorRealloc(MEM_SCRATCH, buf, cap);
+        }
+        ssize_t n = pread(fd, buf + len, cap - len, E->file_offset + len);
+        if (n <= 0) {
+            break;
+        }
+        len += n;
+    }
+    bool eof = len == avail;
+    // 最後まで読んだ時だけ、保存する時に書き換えられたと見なさないように今の状態を覚える
+    if (eof) {
+        editorFileStampSet(&E->file_stamp, fd, &st);
+    }
+    E->follow_pending = !eof;
+    close(fd);
+
+    // 仮の行の下に行を足していなければ、最後の行にいるカーソルを追記した行に付いていかせる
+    bool at_end = E->cy >= E->numrows - 1 && (E->file_tail < 0 || E->file_tail == E->numrows - 1);
+    int at = E->numrows;
+    int removed = 0;
+    if (E->file_tail >= 0) {
+        at = E->file_tail;
+        editorDeleteRow(E, at);
+        E->file_tail = -1;
+        removed = 1;
+    }
+    int first = at;
+
+    int rows = 0;
+    char *p = buf;
+    char *end = buf + len;
+    while (p < end) {
+        char *eol = memchr(p, '\n', end - p);
+        if (eol == NULL) {
+            // 最後の改行の無い部分は、ファイルの末尾まで読んだ時だけ仮の行にする
+            if (eof) {
+                editorAppendRow(E, at, p, end - p);
+                E->file_tail = at++;
+                rows++;
+            }
+            break;
+        }
+        char *next = eol + 1;
+        E->file_offset += next - p;
+        while (eol > p && eol[-1] == '\r') {
+            eol--;
+        }
+        editorAppendRow(E, at++, p, eol - p);
+        rows++;
+        p = next;
+    }
+    E->dirty = dirty;
+    editorMemFree(buf);
+
+    if (E->follow_scroll && at_end && at > 0) {
+        E->cy = at - 1;
+        E->cx = 0;
+    } else {
+        // 仮の行の下に足してあった行にいたカーソルは、入れた行の分だけずらす
+        if (E->cy > first) {
+            E->cy += rows - removed;
+        }
+        if (E->cy < E->numrows && E->cx > E->row[E->cy].size) {
+            E->cx = E->row[E->cy].size;
+        }
+    }
+    TRACE_END("follow", span);
+    return rows;
+}
+
+/// at 行目から del 行を消して ins 行を入れた時に、仮の行の位置を直す関数 (仮の行を消したら -1)
+void editorTailSplice(editorConfig *E, int at, int del, int ins) {
+    if (E->file_tail >= at + del) {
+        E->file_tail += ins - del;
+    } else if (E->file_tail >= at) {
+        E->file_tail = -1;
+    }
+}
+
+/// 行の文字列が s の len 文字と同じかを返す関数 (len は行末のキャリッジリターンを除いた長さ)
+bool editorRowEquals(erow *row, char *s, int len) {
+    return row->size == len && memcmp(editorRowChars(row), s, len) == 0;
+}
+
+/// ファイルの 1 行の長さから、editorOpen と同じく行末のキャリッジリターンを除く関数
+int editorLineLength(char *s, long len) {
+    while (len > 0 && s[len - 1] == '\r') {
+        len--;
+    }
+    return len;
+}
+
+/// 読み込み直したファイルとの差分 1 つを当てて、変わった行数を返す関数
+// バッファの at 行目から del 行を、新しい行 (data の starts と lens の ins 行) で置き換える。
+// 行数が同じ部分はその場で中身を入れ替え、増減する分はまとめて 1 回の memmove で詰める (広げる)。
+// カーソルとスクロールの位置は、この差分より下にあればその分だけずらす。
+int editorReloadHunk(editorConfig *E, int at, int del, char *data, long *starts, int *lens, int ins) {
+    int same = del < ins ? del : ins;
+    for (int i = 0; i < same; i++) {
+        erow *row = &E->row[at + i];
+        editorFreeRow(row);
+        editorRowInit(E, row, data + starts[i], lens[i], lens[i] <= KEDITOR_ARENA_MAX_ROW);
+    }
+
+    if (del > ins) {
+        for (int i = same; i < del; i++) {
+            editorFreeRow(&E->row[at + i]);
+        }
+        memmove(&E->row[at + ins], &E->row[at + del], sizeof(erow) * (E->numrows - at - del));
+        E->numrows -= del - ins;
+        editorInvalidateSyntax(E, at + ins);
+        editorDamage(E, at + ins, INT_MAX);
+        editorFilterSplice(E, at + ins, del - ins, 0);
+        editorFoldSplice(E, at + ins, del - ins, 0);
+        editorAnchorSplice(E, at + ins, del - ins, 0);
+        editorTailSplice(E, at + ins, del - ins, 0);
+        editorLoadSplice(E, at + ins, del - ins, 0);
+    } else if (ins > del) {
+        E->row = editorRealloc(MEM_ROWS, E->row, sizeof(erow) * (E->numrows + ins - del));
+        memmove(&E->row[at + ins], &E->row[at + del], sizeof(erow) * (E->numrows - at - del));
+        E->numrows += ins - del;
+        editorDamage(E, at + del, INT_MAX);
+        editorFilterSplice(E, at + del, 0, ins - del);
+        editorFoldSplice(E, at + del, 0, ins - del);
+        editorAnchorSplice(E, at + del, 0, ins - del);
+        editorTailSplice(E, at + del, 0, ins - del);
+        editorLoadSplice(E, at + del, 0, ins - del);
+        for (int i = same; i < ins; i++) {
+            editorRowInit(E, &E->row[at + i], data + starts[i], lens[i], lens[i] <= KEDITOR_ARENA_MAX_ROW);
+        }
+    }
+
+    // 置き換えた行の中にいた時は、残った行の中に収める (他のウィンドウのカーソルとスクロールの位置も)
+    for (int w = -1; w < E->numwindows; w++) {
+        if (w == E->window) {
+            continue;
+        }
+        int *positions[] = {
+            w < 0 ? &E->cy : &E->windows[w].cy,
+            w < 0 ? &E->rowoff : &E->windows[w].rowoff,
+        };
+        for (int i = 0; i < 2; i++) {
+            int *p = positions[i];
+            if (*p >= at + del) {
+                *p += ins - del;
+            } else if (*p >= at + ins) {
+                *p = at + ins;
+            }
+        }
+    }
+    return del > ins ? del : ins;
+}
+
+/// バッファの top 行目からの n 行と、新しい m 行の行単位の差分を取り、下から順に当てて変わった行数を返す関数
+// Myers の O(ND) 法で、手数 d ごとに各対角線 k で進めた所 (x) を v に持つ。
+// 編集を後から辿るため、d ごとに v の [-d-1, d+1] を trace に取っておく (全部で O(D^2))。
+// 行の比較はハッシュを先に比べ、一致した時だけ文字列を比べる。
+// 手数が KEDITOR_RELOAD_MAX_EDITS を超える時は、n 行をまとめて m 行に置き換える。
+int editorReloadDiff(editorConfig *E, int top, int n, char *data, long *starts, int *lens, int m) {
+    unsigned int *hash = editorMalloc(MEM_SCRATCH, sizeof(unsigned int) * (n + m + 1));
+    unsigned int *ha = hash;
+    unsigned int *hb = hash + n;
+    for (int i = 0; i < n; i++) {
+        erow *row = &E->row[top + i];
+        ha[i] = editorKeywordHash(editorRowChars(row), row->size, 0);
+    }
+    for (int j = 0; j < m; j++) {
+        hb[j] = editorKeywordHash(data + starts[j], lens[j], 0);
+    }
+
+    int maxd = n + m < KEDITOR_RELOAD_MAX_EDITS ? n + m : KEDITOR_RELOAD_MAX_EDITS;
+    int off = maxd + 1;
+    int *v = editorMalloc(MEM_SCRATCH, sizeof(int) * (2 * maxd + 3));
+    memset(v, 0, sizeof(int) * (2 * maxd + 3));
+    int *trace = NULL;
+    size_t trace_cap = 0;
+    int found = -1;
+    for (int d = 0; d <= maxd && found < 0; d++) {
+        // d 手目の分は trace[d * d + 2 * d] から 2 * d + 3 個
+        size_t base = (size_t) d * d + 2 * d;
+        if (base + 2 * d + 3 > trace_cap) {
+            trace_cap = (base + 2 * d + 3) * 2;
+            trace = editorRealloc(MEM_SCRATCH, trace, sizeof(int) * trace_cap);
+        }
+        memcpy(trace + base, v + off - d - 1, sizeof(int) * (2 * d + 3));
+
+        for (int k = -d; k <= d; k += 2) {
+            int x = (k == -d || (k != d && v[off + k - 1] < v[off + k + 1])) ? v[off + k + 1] : v[off + k - 1] + 1;
+            int y = x - k;
+            while (x < n && y < m && ha[x] == hb[y] && editorRowEquals(&E->row[top + x], data + starts[y], lens[y])) {
+                x++;
+                y++;
+            }
+            v[off + k] = x;
+            if (x >= n && y >= m) {
+                found = d;
+                break;
+            }
+        }
+    }
+
+    int changed = 0;
+    if (found < 0) {
+        changed = editorReloadHunk(E, top, n, data, starts, lens, m);
+    } else {
+        // (n, m) から (0, 0) へ逆に辿り、一致する行が続く所で区切った差分を下から当てる
+        int x = n;
+        int y = m;
+        int hx = n;
+        int hy = m;
+        for (int d = found; d >= 0; d--) {
+            int *vd = trace + (size_t) d * d + 3 * d + 1;
+            int k = x - y;
+            int prev_k = (k == -d || (k != d && vd[k - 1] < vd[k + 1])) ? k + 1 : k - 1;
+            int prev_x = vd[prev_k];
+            int prev_y = prev_x - prev_k;
+            if (x > prev_x && y > prev_y) {
+                changed += editorReloadHunk(E, top + x, hx - x, data, starts + y, lens + y, hy - y);
+                while (x > prev_x && y > prev_y) {
+                    x--;
+                    y--;
+                }
+                hx = x;
+                hy = y;
+            }
+            if (d > 0) {
+                x = prev_x;
+                y = prev_y;
+            }
+        }
+        changed += editorReloadHunk(E, top + x, hx - x, data, starts + y, lens + y, hy - y);
+    }
+
+    editorMemFree(trace);
+    editorMemFree(v);
+    editorMemFree(hash);
+    return changed;
+}
+
+/// 他のプロセスが書き換えたファイルを読み込み直して、変わった行数を返す関数
+// ファイルを mmap し、バッファと先頭と末尾で一致する行はそのまま残して、間の部分だけ行単位の差分を取る。
+// 変わった行だけを置き換えるので、残った行の文字列やハイライト、カーソルとスクロールの位置は保たれる。
+// 先頭と末尾の一致は行の位置を覚えずに走査するので、大きなファイルの一部の変更でも余分な領域を使わない。
+// 未保存の変更は失われる (E->dirty の時に呼ぶかは呼び出し側が決める)。読み込めなかった時は -1 を返す。
+int editorReload(editorConfig *E) {
+    if (E->filename == NULL) {
+        return -1;
+    }
+    // 読み込んでいる途中の行とファイルを比べても意味が無いので、先に最後まで読み込む
+    editorLoadFinish(E);
+    int fd = open(E->filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    long size = st.st_size;
+    char *data = NULL;
+    if (size > 0) {
+        data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+    }
+    editorFileStampSet(&E->file_stamp, fd, &st);
+    close(fd);
+    TRACE_BEGIN(span);
+
+    // 先頭から一致する行
+    int top = 0;
+    long pos = 0;
+    while (top < E->numrows && pos < size) {
+        char *eol = memchr(data + pos, '\n', size - pos);
+        long line_end = eol ? eol - data : size;
+        if (!editorRowEquals(&E->row[top], data + pos, editorLineLength(data + pos, line_end - pos))) {
+            break;
+        }
+        top++;
+        pos = eol ? line_end + 1 : size;
+    }
+
+    // 末尾から一致する行 (先頭で一致した所とは重ねない)
+    int bottom = E->numrows;
+    long end = size;
+    while (bottom > top && end > pos) {
+        long line_end = data[end - 1] == '\n' ? end - 1 : end;
+        char *newline = memrchr(data + pos, '\n', line_end - pos);
+        long start = newline ? newline - data + 1 : pos;
+        if (!editorRowEquals(&E->row[bottom - 1], data + start, editorLineLength(data + start, line_end - start))) {
+            break;
+        }
+        bottom--;
+        end = start;
+    }
+
+    // 間の部分の行の位置
+    int m = 0;
+    int cap = 0;
+    long *starts = NULL;
+    int *lens = NULL;
+    for (long p = pos; p < end;) {
+        char *eol = memchr(data + p, '\n', end - p);
+        long line_end = eol ? eol - data : end;
+        if (m == cap) {
+            cap = cap ? cap * 2 : 64;
+            starts = editorRealloc(MEM_SCRATCH, starts, sizeof(long) * cap);
+            lens = editorRealloc(MEM_SCRATCH, lens, sizeof(int) * cap);
+        }
+        starts[m] = p;
+        lens[m] = editorLineLength(data + p, line_end - p);
+        m++;
+        p = eol ? line_end + 1 : end;
+    }
+
+    int changed = 0;
+    if (bottom > top || m > 0) {
+        changed = editorReloadDiff(E, top, bottom - top, data, starts, lens, m);
+    }
+    editorMemFree(starts);
+    editorMemFree(lens);
+
+    E->dirty = 0;
+    if (E->cy > E->numrows) {
+        E->cy = E->numrows;
+    }
+    if (E->rowoff > E->cy) {
+        E->rowoff = E->cy;
+    }
+    int rowlen = E->cy < E->numrows ? E->row[E->cy].size : 0;
+    if (E->cx > rowlen) {
+        E->cx = rowlen;
+    }
+
+    // 追記された分を editorFollow で読むための位置も、読み込み直した内容に合わせる
+    char *last = size > 0 ? memrchr(data, '\n', size) : NULL;
+    E->file_offset = last ? last - data + 1 : 0;
+    E->file_tail = E->file_offset < size && E->numrows > 0 ? E->numrows - 1 : -1;
+    if (data) {
+        munmap(data, size);
+    }
+    TRACE_END("reload", span);
+    return changed;
+}
+
+/// ファイル名を設定し、それに合わせてハイライトの設定を選び直す関数
+void editorSetFilename(editorConfig *E, char *filename) {
+    if (filename != E->filename) {
+        free(E->filename);
+        E->filename = strdup(filename);
+        E->file_stamp.valid = false;
+    }
+    editorSelectSyntaxHighlight(E);
+}
+
+/// 大きなファイルを開く時に、索引のキャッシュを探す関数
+// キャッシュを使う (書き出す) なら true を返し、キーが一致するキャッシュがあれば *hit を true にする。
+bool editorSidecarBegin(editorConfig *E, int fd, sidecarIndex *index, bool *hit) {
+    struct stat st;
+    if (E->cache_dir == NULL || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size < KEDITOR_SIDECAR_MIN_BYTES) {
+        return false;
+    }
+    if (sidecarKey(index, fd, &st) < 0) {
+        return false;
+    }
+    *hit = sidecarLoad(E->cache_dir, index) == 0;
+    return true;
+}
+
+/// キャッシュしておいたハイライトの状態を at 行目に戻す関数
+void editorSidecarRestoreRow(editorConfig *E, sidecarIndex *index, int at) {
+    erow *row = &E->row[at];
+    row->hl_start = at > 0 ? (index->hl[(at - 1) / 8] >> ((at - 1) % 8)) & 1 : 0;
+    row->hl_open_comment = (index->hl[at / 8] >> (at % 8)) & 1;
+    row->hl_dirty = false;
+    row->hl_pending = true;
+}
+
+/// キャッシュしておいたハイライトの状態を行に戻す関数 (editorSyntaxPrepass と同じ状態になる)
+// 状態を計算した時とファイルの種類が違えば false を返す。
+bool editorSidecarRestore(editorConfig *E, sidecarIndex *index) {
+    if (!index->header.has_hl || strcmp(index->header.filetype, E->syntax->filetype) != 0) {
+        return false;
+    }
+    for (int at = 0; at < E->numrows; at++) {
+        editorSidecarRestoreRow(E, index, at);
+    }
+    E->hl_frontier = E->numrows;
+    return true;
+}
+
+/// 読み込んだ結果を索引のキャッシュに書き出す関数 (行の位置は index->offsets に入れてある)
+// 書き出せなくても開くのには困らないので、失敗は無視する。
+void editorSidecarStore(editorConfig *E, sidecarIndex *index, int lines, bool has_hl) {
+    sidecarHeader *header = &index->header;
+    header->numrows = lines;
+    header->noffsets = (lines + KEDITOR_SIDECAR_STRIDE - 1) / KEDITOR_SIDECAR_STRIDE;
+    header->file_offset = E->file_offset;
+    header->file_tail = E->file_tail >= 0;
+    header->has_hl = has_hl;
+    memset(header->filetype, 0, sizeof(header->filetype));
+    if (E->syntax) {
+        snprintf(header->filetype, sizeof(header->filetype), "%s", E->syntax->filetype);
+    }
+
+    editorMemFree(index->hl);
+    index->hl = NULL;
+    if (has_hl) {
+        index->hl = editorMalloc(MEM_SCRATCH, ((size_t) lines + 7) / 8);
+        memset(index->hl, 0, ((size_t) lines + 7) / 8);
+        for (int at = 0; at < lines; at++) {
+            index->hl[at / 8] |= E->row[at].hl_open_comment << (at % 8);
+        }
+    }
+    sidecarSave(E->cache_dir, index);
+}
+
+/// ファイルを読み込む関数
+// 開けなかった時は -1 を返し、errno はそのまま残す。
+int editorOpen(editorConfig *E, char *filename) {
+    if (editorOpenBegin(E, filename) < 0) {
+        return -1;
+    }
+    editorLoadFinish(E);
+    return 0;
+}
+
+/// ファイルを開いて、少しずつ読み込み始める関数
+// 行は editorLoadStep を呼ぶたびに後ろに追加していき、最後まで読み込むと E->load は NULL に戻る。
+// 索引のキャッシュがあれば、全ての行を仮の行として作ってしまい、ブロックごとに読み込む (editorLoadRows)。
+// 開けなかった時は -1 を返し、errno はそのまま残す。
+int editorOpenBegin(editorConfig *E, char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        return -1;
+    }
+
+    editorSetFilename(E, filename);
+    if (E->intern_lines) {
+        editorInternBegin(E);
+    }
+
+    editorLoad *load = editorMalloc(MEM_SCRATCH, sizeof(editorLoad));
+    struct stat st;
+    load->fp = fp;
+    load->size = fstat(fileno(fp), &st) == 0 ? st.st_size : 0;
+    load->pos = 0;
+    load->lines = 0;
+    load->line = NULL;
+    load->linecap = 0;
+    // 大きなファイルは、前に開いた時の索引のキャッシュを探す
+    load->hit = false;
+    load->indexing = editorSidecarBegin(E, fileno(fp), &load->index, &load->hit);
+    load->offsets_cap = 0;
+    load->stubs = false;
+    load->hl_cached = false;
+    load->block_row = NULL;
+    load->block_done = NULL;
+    load->blocks_left = 0;
+    load->next_block = 0;
+    E->load = load;
+    if (load->hit && E->numrows == 0 && load->index.header.numrows > 0) {
+        editorLoadStubs(E);
+    }
+    return 0;
+}
+
+/// 索引のキャッシュの行数だけ空の仮の行を作り、ブロックごとに読み込む準備をする関数
+// 行数とファイルの最後の改行の位置はキャッシュの通りにしておき、ハイライトの状態もあれば戻しておく。
+void editorLoadStubs(editorConfig *E) {
+    editorLoad *load = E->load;
+    sidecarHeader *header = &load->index.header;
+    int numrows = header->numrows;
+    int blocks = header->noffsets;
+    E->row = editorMalloc(MEM_ROWS, sizeof(erow) * numrows);
+    memset(E->row, 0, sizeof(erow) * numrows);
+    for (int at = 0; at < numrows; at++) {
+        E->row[at].inline_text = true;
+        E->row[at].hl_dirty = true;
+    }
+    E->numrows = numrows;
+    E->file_offset = header->file_offset;
+    E->file_tail = header->file_tail ? numrows - 1 : -1;
+
+    load->block_row = editorMalloc(MEM_SCRATCH, sizeof(int) * blocks);
+    load->block_done = editorMalloc(MEM_SCRATCH, sizeof(bool) * blocks);
+    for (int k = 0; k < blocks; k++) {
+        load->block_row[k] = k * KEDITOR_SIDECAR_STRIDE;
+        load->block_done[k] = false;
+    }
+    load->blocks_left = blocks;
+    load->stubs = true;
+    load->hl_cached = E->syntax && editorSidecarRestore(E, &load->index);
+}
+
+/// 読み込んでいる途中のファイルから bytes バイト程度の行を読み込んで、追加した行数を返す関数
+// 最後まで読み込んだら editorLoadEnd で後始末をする。
+// 読み込んだ行は編集ではないので、読み込んでいる間に編集されていても E->dirty は変えない。
+int editorLoadStep(editorConfig *E, long bytes) {
+    editorLoad *load = E->load;
+    if (load == NULL) {
+        return 0;
+    }
+    // ブロックごとに読み込んでいる時は、まだ読み込んでいないブロックを前から順に読み込む
+    if (load->stubs) {
+        long start = load->pos;
+        int rows = 0;
+        while (E->load && load->pos - start < bytes) {
+            while (load->block_done[load->next_block]) {
+                load->next_block++;
+            }
+            rows += editorLoadBlock(E, load->next_block);
+        }
+        return rows;
+    }
+    TRACE_BEGIN(span);
+
+    int dirty = E->dirty;
+    long start = load->pos;
+    int rows = 0;
+    bool eof = false;
+    ssize_t linelen;
+
+    // hogehoge != 1 にしていたため、改行があると、それ移行描画されない Bug が生じていた。
+    while (load->pos - start < bytes) {
+        if ((linelen = getline(&load->line, &load->linecap, load->fp)) == -1) {
+            eof = true;
+            break;
+        }
+        char *line = load->line;
+        // 索引のキャッシュに書き出すために、行の位置を覚えておく
+        if (load->indexing && load->lines % KEDITOR_SIDECAR_STRIDE == 0) {
+            int k = load->lines / KEDITOR_SIDECAR_STRIDE;
+            if (k >= load->offsets_cap) {
+                load->offsets_cap = load->offsets_cap ? load->offsets_cap * 2 : 1024;
+                load->index.offsets = editorRealloc(
+                    MEM_SCRATCH, load->index.offsets, sizeof(int64_t) * load->offsets_cap
+                );
+            }
+            load->index.offsets[k] = load->pos;
+        }
+        load->lines++;
+        load->pos += linelen;
+        // 追記された分を editorFollow で読むために、最後の改行までの位置を覚えておく
+        bool tail = line[linelen - 1] != '\n';
+        if (!tail) {
+            E->file_offset += linelen;
+        }
+        // E,row[hoge].chars に改行やキャリッジリターンを格納しない。
+        while (linelen > 0 && (line[linelen - 1] == '\r' || line[linelen - 1] == '\n')) {
+            linelen--;
+        }
+        editorLoadRow(E, line, linelen);
+        if (tail) {
+            E->file_tail = E->numrows - 1;
+        }
+        rows++;
+    }
+
+    E->dirty = dirty;
+    TRACE_END("load", span);
+    if (eof) {
+        editorLoadEnd(E);
+    }
+    return rows;
+}
+
+/// 読み込んでいる途中のファイルを、少なくとも rows 行になるまで (ファイルが短ければ最後まで) 読み込む関数
+void editorLoadUntil(editorConfig *E, int rows) {
+    while (E->load && E->numrows < rows) {
+        editorLoadStep(E, KEDITOR_LOAD_STEP_BYTES);
+    }
+}
+
+/// 読み込んでいる途中のファイルを最後まで読み込む関数
+void editorLoadFinish(editorConfig *E) {
+    while (E->load) {
+        editorLoadStep(E, LONG_MAX);
+    }
+}
+
+/// ブロックごとに読み込んでいる時に、from 行目から to 行目の手前までを含むブロックを読み込む関数
+// 前から順に読み込んでいる時は何もしない (editorLoadUntil を使う)。
+void editorLoadRows(editorConfig *E, int from, int to) {
+    editorLoad *load = E->load;
+    if (load == NULL || !load->stubs) {
+        return;
+    }
+    if (from < 0) {
+        from = 0;
+    }
+    if (to > E->numrows) {
+        to = E->numrows;
+    }
+    if (from >= to) {
+        return;
+    }
+    // from 行目を含むブロック (先頭の行が from 以下の最後のブロック) を二分探索で探す
+    int blocks = load->index.header.noffsets;
+    int lo = 0;
+    int hi = blocks;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (load->block_row[mid] <= from) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (int k = lo > 0 ? lo - 1 : 0; E->load && k < blocks && load->block_row[k] < to; k++) {
+        if (!load->block_done[k]) {
+            editorLoadBlock(E, k);
+        }
+    }
+}
+
+/// k 番目のブロックをファイルから読み込んで仮の行と置き換え、読み込んだ行数を返す関数
+// 読み込んだ行は編集ではないので、E->dirty とファイルの最後の仮の行の位置は変えない。
+// 全てのブロックを読み込んだら editorLoadEnd で後始末をする。
+int editorLoadBlock(editorConfig *E, int k) {
+    editorLoad *load = E->load;
+    sidecarIndex *index = &load->index;
+    TRACE_BEGIN(span);
+
+    int first = k * KEDITOR_SIDECAR_STRIDE;
+    int count = index->header.numrows - first;
+    count = count < KEDITOR_SIDECAR_STRIDE ? count : KEDITOR_SIDECAR_STRIDE;
+    int base = load->block_row[k];
+    int dirty = E->dirty;
+    int tail = E->file_tail;
+    int frontier = E->hl_frontier;
+    // 編集したりファイルの種類を変えたりしていなければ、キャッシュしたハイライトの状態をそのまま使える
+    bool cached = load->hl_cached && E->dirty == 0 && E->syntax &&
+                  strcmp(index->header.filetype, E->syntax->filetype) == 0;
+    int rows = 0;
+    ssize_t linelen;
+
+    if (fseeko(load->fp, index->offsets[k], SEEK_SET) == 0) {
+        while (rows < count && (linelen = getline(&load->line, &load->linecap, load->fp)) != -1) {
+            load->pos += linelen;
+            while (linelen > 0 && (load->line[linelen - 1] == '\r' || load->line[linelen - 1] == '\n')) {
+                linelen--;
+            }
+            erow *row = &E->row[base + rows];
+            editorFreeRow(row);
+            editorRowInit(E, row, load->line, linelen, linelen <= KEDITOR_ARENA_MAX_ROW);
+            if (cached) {
+                editorSidecarRestoreRow(E, index, base + rows);
+            }
+            rows++;
+        }
+    }
+    E->dirty = dirty;
+    E->file_tail = tail;
+    if (cached) {
+        E->hl_frontier = frontier;
+    }
+    // ファイルが短くなっていて読めなかった行は空のまま残す (行数が合わないので、キャッシュは使わなくなる)
+    load->lines += rows;
+    load->block_done[k] = true;
+    load->blocks_left--;
+    TRACE_END("load block", span);
+    if (load->blocks_left == 0) {
+        editorLoadEnd(E);
+    }
+    return rows;
+}
+
+/// 行の追加と削除に合わせて、ブロックの先頭の行の番号をずらす関数
+void editorLoadSplice(editorConfig *E, int at, int del, int ins) {
+    editorLoad *load = E->load;
+    if (load == NULL || !load->stubs) {
+        return;
+    }
+    for (int k = 0; k < load->index.header.noffsets; k++) {
+        if (load->block_row[k] >= at + del) {
+            load->block_row[k] += ins - del;
+        } else if (load->block_row[k] > at) {
+            load->block_row[k] = at;
+        }
+    }
+}
+
+/// ファイルを最後まで読み込んだ後の後始末をする関数
+// ハイライトの状態は、索引のキャッシュと行数まで一致すれば全ての行を走査せずに戻す。
+// 読み込んでいる間に編集された時は、行がファイルと一致しないのでキャッシュは使わず、書き出しもしない。
+void editorLoadEnd(editorConfig *E) {
+    editorLoad *load = E->load;
+    TRACE_BEGIN(span);
+    free(load->line);
+    fclose(load->fp);
+    editorInternEnd(E);
+    editorStampFile(E);
+
+    bool clean = E->dirty == 0 && E->numrows == load->lines;
+    bool hit = clean && load->hit && load->lines == load->index.header.numrows &&
+               E->file_offset == load->index.header.file_offset;
+    bool restored = hit && E->syntax && editorSidecarRestore(E, &load->index);
+    if (!restored) {
+        editorSyntaxPrepass(E);
+    }
+    // キャッシュが無かったか古かった時と、ハイライトの状態を新しく計算した時は書き出す
+    bool has_hl = E->syntax && E->hl_frontier >= E->numrows;
+    if (load->indexing && clean && (!hit || (has_hl && !restored))) {
+        editorSidecarStore(E, &load->index, load->lines, has_hl);
+    }
+    if (load->indexing) {
+        sidecarFree(&load->index);
+    }
+    editorMemFree(load->block_row);
+    editorMemFree(load->block_done);
+    editorMemFree(load);
+    E->load = NULL;
+    TRACE_END("open", span);
+}
+
+// ファイルから読み込んだ実体を表示用に変換する
+void editorUpdateRow(editorConfig *E, erow *row) {
+    TRACE_BEGIN(update);
+    // 編集された仮の行は、追記された続きで置き換えずに普通の行として残す
+    if (row - E->row == E->file_tail) {
+        E->file_tail = -1;
+    }
+    char *chars = editorRowChars(row);
+    if (!row->arena) {
+        editorMemFree(row->display);
+    } else if (row->display) {
+        editorArenaRelease(row->display, editorRowDisplaySize(row));
+    }
+    row->display = NULL;
+
+    // タブを展開した後の文字数
+    int rsize = 0;
+    bool tabs = false;
+    for (int i = 0; i < row->size; i++) {
+        if (chars[i] == '\t') {
+            rsize += KEDITOR_TAB_STOP - (rsize % KEDITOR_TAB_STOP);
+            tabs = true;
+        } else {
+            rsize++;
+        }
+    }
+    row->tabs = tabs;
+
+    // タブが無ければ render は文字列そのものなので作らない。
+    // タブがあれば rsize と render と hl を 1 つの領域にまとめて確保する。
+    if (tabs) {
+        size_t size = sizeof(int) + sizeof(char) * (rsize + 1) + rsize;
+        char *display = row->arena ? editorArenaAlloc(E, size) : editorMalloc(MEM_RENDER, size);
+        editorRowExpandTabs(row, display);
+        row->display = display;
+    }
+
+    // ハイライトはここでは計算せず、描画時かアイドル時にまとめて行う。
+    row->hl_dirty = true;
+    editorInvalidateSyntax(E, row - E->row);
+    editorDamage(E, row - E->row, row - E->row + 1);
+    if (E->filter) {
+        editorFilterUpdateRow(E, row - E->row);
+    }
+    TRACE_END("row update", update);
+}
+
+/// タブを展開した表示用の文字数を数える関数
+int editorRowMeasure(erow *row) {
+    char *chars = editorRowChars(row);
+    int rsize = 0;
+    for (int j = 0; j < row->size; j++) {
+        if (chars[j] == '\t') {
+            rsize += KEDITOR_TAB_STOP - (rsize % KEDITOR_TAB_STOP);
+        } else {
+            rsize++;
+        }
+    }
+    return rsize;
+}
+
+/// タブを展開した文字列を display に書き込む関数 (先頭に rsize を置き、その後に render (rsize + 1 バイト) を続ける)
+void editorRowExpandTabs(erow *row, char *display) {
+    char *chars = editorRowChars(row);
+    char *render = display + sizeof(int);
+    int index = 0;
+    for (int j = 0; j < row->size; j++) {
+        if (chars[j] == '\t') {
+            render[index++] = ' ';
+            while (index % KEDITOR_TAB_STOP != 0) {
+                render[index++] = ' ';
+            }
+        } else {
+            render[index++] = chars[j];
+        }
+    }
+    render[index] = '\0';
+    memcpy(display, &index, sizeof(index));
+}
+
+// 行を追加する関数
+void editorAppendRow(editorConfig *E, int at, char *s, size_t len) {
+    editorInsertRow(E, at, s, len, false);
+}
+
+/// ファイルから読み込んだ行を末尾に追加する関数 (行の文字列はアリーナから切り出す)
+// 長すぎる行は、1 行でスラブの大部分を使ってしまうので行ごとに確保する。
+void editorLoadRow(editorConfig *E, char *s, size_t len) {
+    editorInsertRow(E, E->numrows, s, len, len <= KEDITOR_ARENA_MAX_ROW);
+}
+
+/// at 行目に行を追加する関数
+// arena が true なら、chars と render を行ごとに確保せずにアリーナから切り出す。
+void editorInsertRow(editorConfig *E, int at, char *s, size_t len, bool arena) {
+    if (at < 0 || at > E->numrows) {
+        return;
+    }
+    // まだ読み込んでいない行の間には追加しない
+    editorLoadRows(E, at - 1, at + 1);
+
+    E->row = editorRealloc(MEM_ROWS, E->row, sizeof(erow) * (E->numrows + 1));
+    memmove(&E->row[at + 1], &E->row[at], sizeof(erow) * (E->numrows - at));
+    editorDamage(E, at, INT_MAX);
+    editorFilterSplice(E, at, 0, 1);
+    editorFoldSplice(E, at, 0, 1);
+    editorAnchorSplice(E, at, 0, 1);
+    editorTailSplice(E, at, 0, 1);
+    editorLoadSplice(E, at, 0, 1);
+
+    editorRowInit(E, &E->row[at], s, len, arena);
+
+    E->numrows++;
+    E->dirty++;
+}
+
+/// row に新しい行の内容を設定する関数 (row はバッファの中にあり、持っていた領域は解放してあること)
+void editorRowInit(editorConfig *E, erow *row, char *s, size_t len, bool arena) {
+    row->size = len;
+    row->arena = arena;
+    row->cold = false;
+    // 短い行は erow の中に直接持つ
+    row->inline_text = len < KEDITOR_ROW_INLINE;
+    // ファイルの中身を E->row[at] に格納する処理の実装
+    if (row->inline_text) {
+        memcpy(row->text.buf, s, len);
+        row->text.buf[len] = '\0';
+    } else if (arena) {
+        row->text.ptr = editorArenaText(E, s, len);
+    } else {
+        row->text.ptr = editorMalloc(MEM_TEXT, sizeof(char) * (len + 1));
+        memcpy(row->text.ptr, s, len);
+        row->text.ptr[len] = '\0';
+    }
+    row->display = NULL;
+    row->tabs = false;
+    row->hl_start = 0;
+    row->hl_open_comment = 0;
+    row->hl_dirty = true;
+    row->hl_pending = false;
+
+    editorUpdateRow(E, row);
+}
+
+void editorInsertNewLine(editorConfig *E) {
+    if (E->cx == 0) {
+        editorAppendRow(E, E->cy, "", 0);
+    } else {
+        erow *row = &E->row[E->cy];
+        char *tail = &editorRowChars(row)[E->cx];
+        int len = row->size - E->cx;
+        // 短い行の文字列は E->row の中にあり、editorAppendRow の realloc で動くので先に写しておく
+        char buf[KEDITOR_ROW_INLINE];
+        if (row->inline_text) {
+            memcpy(buf, tail, len);
+            tail = buf;
+        }
+        editorAppendRow(E, E->cy + 1, tail, len);
+        // カーソルより後ろの目印は、新しい行に移す
+        editorAnchorMove(E, E->cy, E->cx, E->cy + 1, 0);
+        // editorAppendRow 内で realloc() が呼出されるので、E->row に割り当てられるアドレスが変更される可能性がある。
+        row = &E->row[E->cy];
+        // 行末で改行した時は、元の行は変わらない
+        if (E->cx < row->size) {
+            editorRowDetach(row);
+            row->size = E->cx;
+            editorRowChars(row)[row->size] = '\0';
+            editorUpdateRow(E, row);
+        }
+    }
+    E->cy++;
+    E->cx = 0;
+}
+
+/* Syntax Highlighting */
+
+int is_separator(int c) {
+    return separator_table[(unsigned char) c];
+}
+
+/// is_separator の判定表を作る関数
+// 文字ごとに strchr で探すとハイライトの度に遅くなるので、起動時に一度だけ作っておく。
+void editorInitSeparators() {
+    for (int c = 0; c < 256; c++) {
+        separator_table[c] = isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != NULL;
+    }
+}
+
+unsigned int editorKeywordHash(char *s, int len, unsigned int seed) {
+    unsigned int h = 2166136261u ^ seed;
+    for (int i = 0; i < len; i++) {
+        h ^= (unsigned char) s[i];
+        h *= 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+/// keywords から衝突の無いハッシュ表を作る関数
+// 表の大きさはキーワード数の 2 倍以上の 2 のべき乗から始め、
+// 衝突しない seed が見つからなければ表を広げて探し直す。
+void editorSyntaxCompileKeywords(editorSyntax *syntax) {
+    int count = 0;
+    while (syntax->keywords[count]) {
+        count++;
+    }
+
+    unsigned int size = 1;
+    while (size < (unsigned int) count * 2) {
+        size <<= 1;
+    }
+
+    while (true) {
+        editorKeyword *table = calloc(size, sizeof(editorKeyword));
+        // 表を作れなければキーワードを色付けしないだけにする
+        if (table == NULL) {
+            return;
+        }
+        for (unsigned int seed = 0; seed < 4096; seed++) {
+            bool collided = false;
+            int maxlen = 0;
+            memset(table, 0, sizeof(editorKeyword) * size);
+            for (int j = 0; j < count && !collided; j++) {
+                char *name = syntax->keywords[j];
+                int len = strlen(name);
+                int kw2 = name[len - 1] == '|';
+                if (kw2) {
+                    len--;
+                }
+                editorKeyword *slot = &table[editorKeywordHash(name, len, seed) & (size - 1)];
+                if (slot->name != NULL) {
+                    collided = true;
+                    break;
+                }
+                slot->name = name;
+                slot->len = len;
+                slot->hl = kw2 ? HL_KEYWORD2 : HL_KEYWORD1;
+                if (len > maxlen) {
+                    maxlen = len;
+                }
+            }
+            if (!collided) {
+                syntax->kw_table = table;
+                syntax->kw_mask = size - 1;
+                syntax->kw_seed = seed;
+                syntax->kw_maxlen = maxlen;
+                return;
+            }
+        }
+        free(table);
+        size <<= 1;
+    }
+}
+
+/// s から始まる長さ len の単語がキーワードなら、そのハイライトの種類を返す関数
+int editorSyntaxMatchKeyword(editorConfig *E, char *s, int len) {
+    if (E->syntax->kw_table == NULL || len > E->syntax->kw_maxlen) {
+        return HL_NORMAL;
+    }
+    editorKeyword *slot =
+        &E->syntax->kw_table[editorKeywordHash(s, len, E->syntax->kw_seed) & E->syntax->kw_mask];
+    if (slot->name != NULL && slot->len == len && !memcmp(slot->name, s, len)) {
+        return slot->hl;
+    }
+    return HL_NORMAL;
+}
+
+/// 開始状態 start (ブロックコメントの途中から始まるか) を元に 1 行分のハイライトを計算する関数
+// 他の行には触らない。次の行への伝播は editorSyntaxUpdateUntil が行う。
+void editorUpdateSyntax(editorConfig *E, erow *row, int start) {
+    // タブを含む行の hl は editorUpdateRow で render と一緒に確保してある。
+    // アリーナの行は編集されるまで render が変わらないので、一度切り出した hl をそのまま使う。
+    int rsize = editorRowRsize(row);
+    if (!row->tabs) {
+        if (!row->arena) {
+            row->display = editorRealloc(MEM_HL, row->display, rsize);
+        } else if (row->display == NULL) {
+            row->display = editorArenaAlloc(E, rsize);
+        }
+    }
+    char *render = editorRowRender(row);
+    unsigned char *hl = editorRowHl(row);
+    memset(hl, HL_NORMAL, rsize);
+    row->hl_start = start;
+    row->hl_dirty = false;
+    row->hl_pending = false;
+    editorDamage(E, row - E->row, row - E->row + 1);
+    PERF_COUNT(E->perf.hl_count);
+
+    if (E->syntax == NULL) {
+        row->hl_open_comment = 0;
+        return;
+    }
+
+    char *scs = E->syntax->singleline_comment_start;
+    char *mcs = E->syntax->multiline_comment_start;
+    char *mce = E->syntax->multiline_comment_end;
+
+    int scs_len = scs ? strlen(scs) : 0;
+    int mcs_len = mcs ? strlen(mcs) : 0;
+    int mce_len = mce ? strlen(mce) : 0;
+
+    int prev_sep = 1;
+    int in_string = 0;
+    int in_comment = start;
+
+    int i = 0;
+    while (i < rsize) {
+        char c = render[i];
+        unsigned char prev_hl = (i > 0) ? hl[i - 1] : HL_NORMAL;
+
+        // 1 行コメント
+        if (scs_len && !in_string && !in_comment) {
+            if (!strncmp(&render[i], scs, scs_len)) {
+                memset(&hl[i], HL_COMMENT, rsize - i);
+                break;
+            }
+        }
+
+        // ブロックコメント
+        if (mcs_len && mce_len && !in_string) {
+            if (in_comment) {
+                hl[i] = HL_MLCOMMENT;
+                if (!strncmp(&render[i], mce, mce_len)) {
+                    memset(&hl[i], HL_MLCOMMENT, mce_len);
+                    i += mce_len;
+                    in_comment = 0;
+                    prev_sep = 1;
+                    continue;
+                } else {
+                    i++;
+                    continue;
+                }
+            } else if (!strncmp(&render[i], mcs, mcs_len)) {
+                memset(&hl[i], HL_MLCOMMENT, mcs_len);
+                i += mcs_len;
+                in_comment = 1;
+                continue;
+            }
+        }
+
+        // 文字列
+        if (E->syntax->flags & HL_HIGHLIGHT_STRINGS) {
+            if (in_string) {
+                hl[i] = HL_STRING;
+                if (c == '\\' && i + 1 < rsize) {
+                    hl[i + 1] = HL_STRING;
+                    i += 2;
+                    continue;
+                }
+                if (c == in_string) {
+                    in_string = 0;
+                }
+                i++;
+                prev_sep = 1;
+                continue;
+            } else if (c == '"' || c == '\'') {
+                in_string = c;
+                hl[i] = HL_STRING;
+                i++;
+                continue;
+            }
+        }
+
+        // 数字
+        if (E->syntax->flags & HL_HIGHLIGHT_NUMBERS) {
+            if ((isdigit(c) && (prev_sep || prev_hl == HL_NUMBER)) ||
+                (c == '.' && prev_hl == HL_NUMBER)) {
+                hl[i] = HL_NUMBER;
+                i++;
+                prev_sep = 0;
+                continue;
+            }
+        }
+
+        // キーワード
+        // 区切り文字までを 1 単語として、ハッシュ表を一度引くだけで判定する。
+        if (prev_sep) {
+            int klen = 0;
+            while (i + klen < rsize && !is_separator(render[i + klen])) {
+                klen++;
+            }
+            int kw = klen ? editorSyntaxMatchKeyword(E, &render[i], klen) : HL_NORMAL;
+            if (kw != HL_NORMAL) {
+                memset(&hl[i], kw, klen);
+                i += klen;
+                prev_sep = 0;
+                continue;
+            }
+        }
+
+        prev_sep = is_separator(c);
+        i++;
+    }
+
+    row->hl_open_comment = in_comment;
+}
+
+/// at 行目以降のハイライトを未確定に戻す関数
+void editorInvalidateSyntax(editorConfig *E, int at) {
+    if (at < 0) {
+        at = 0;
+    }
+    if (at < E->hl_frontier) {
+        E->hl_frontier = at;
+    }
+}
+
+/// limit 行目の手前までハイライトの状態 (ブロックコメントが続いているか) を確定させる関数
+// 内容が変わった行と、開始状態が前回と変わった行だけを走査し直す。
+// それ以外の行は開始状態を比べるだけなので、編集した行から画面の下端までの分しか走査しない。
+// hl そのものは作らず、描画する時に editorSyntaxUpdateRange が画面に見えている行の分だけ作る。
+void editorSyntaxUpdateUntil(editorConfig *E, int limit) {
+    if (limit > E->numrows) {
+        limit = E->numrows;
+    }
+
+    int at;
+    for (at = E->hl_frontier; at < limit; at++) {
+        erow *row = &E->row[at];
+        int start = (at > 0) ? E->row[at - 1].hl_open_comment : 0;
+        if (row->hl_dirty || row->hl_start != start) {
+            row->hl_open_comment = editorSyntaxScanState(E, row, start);
+            row->hl_start = start;
+            row->hl_dirty = false;
+            row->hl_pending = true;
+        }
+    }
+
+    if (at > E->hl_frontier) {
+        E->hl_frontier = at;
+    }
+}
+
+/// from 行目から to 行目の手前までを描画できる状態にする関数
+// 状態の連鎖を to まで確定させた上で、状態だけ分かっている行の hl を作る。
+// 圧縮した時に render を捨てた行は、ここで作り直す。
+void editorSyntaxUpdateRange(editorConfig *E, int from, int to) {
+    editorSyntaxUpdateUntil(E, to);
+    if (to > E->numrows) {
+        to = E->numrows;
+    }
+    for (int at = from; at < to; at++) {
+        editorSyntaxPrepareRow(E, &E->row[at]);
+    }
+}
+
+/// 画面に見えている行を描画できる状態にする関数
+// 絞り込みか折りたたみをしている時は、画面の最後の行まで状態を確定させた上で、表示する行の分だけ hl を作る。
+void editorSyntaxUpdateView(editorConfig *E) {
+    if (E->filter == NULL && E->folds == NULL) {
+        editorSyntaxUpdateRange(E, E->rowoff, E->rowoff + E->screenrows);
+        return;
+    }
+    int top = editorViewIndex(E, E->rowoff);
+    editorSyntaxUpdateUntil(E, editorViewRow(E, top + E->screenrows - 1) + 1);
+    for (int y = 0; y < E->screenrows; y++) {
+        int at = editorViewRow(E, top + y);
+        if (at >= E->numrows) {
+            break;
+        }
+        editorSyntaxPrepareRow(E, &E->row[at]);
+    }
+}
+
+/// 状態が確定している 1 行の hl を作る関数 (圧縮した時に render を捨てた行は作り直す)
+void editorSyntaxPrepareRow(editorConfig *E, erow *row) {
+    if (row->tabs && row->display == NULL) {
+        row->display = editorMalloc(MEM_RENDER, editorRowDisplaySize(row));
+        editorRowExpandTabs(row, row->display);
+    }
+    if (row->hl_pending) {
+        editorUpdateSyntax(E, row, row->hl_start);
+    }
+}
+
+/// 1 行を走査して、行末でブロックコメントが開いているかだけを返す関数
+// editorUpdateSyntax からコメントと文字列の判定だけを抜き出したもの。
+// キーワードと数字は区切り文字を含まないので、コメントの状態には影響しない。
+// タブは render で空白に展開されるだけなので、render の代わりに chars を走査しても結果は同じになる。
+int editorSyntaxScanState(editorConfig *E, erow *row, int start) {
+    if (E->syntax == NULL) {
+        return 0;
+    }
+    char *scs = E->syntax->singleline_comment_start;
+    char *mcs = E->syntax->multiline_comment_start;
+    char *mce = E->syntax->multiline_comment_end;
+
+    int scs_len = scs ? strlen(scs) : 0;
+    int mcs_len = mcs ? strlen(mcs) : 0;
+    int mce_len = mce ? strlen(mce) : 0;
+    bool strings = E->syntax->flags & HL_HIGHLIGHT_STRINGS;
+
+    char *chars = editorRowChars(row);
+    int in_string = 0;
+    int in_comment = start;
+
+    int i = 0;
+    while (i < row->size) {
+        char c = chars[i];
+
+        if (scs_len && !in_string && !in_comment &&
+            !strncmp(&chars[i], scs, scs_len)) {
+            break;
+        }
+
+        if (mcs_len && mce_len && !in_string) {
+            if (in_comment) {
+                if (!strncmp(&chars[i], mce, mce_len)) {
+                    i += mce_len;
+                    in_comment = 0;
+                } else {
+                    i++;
+                }
+                continue;
+            } else if (!strncmp(&chars[i], mcs, mcs_len)) {
+                i += mcs_len;
+                in_comment = 1;
+                continue;
+            }
+        }
+
+        if (strings) {
+            if (in_string) {
+                if (c == '\\' && i + 1 < row->size) {
+                    i += 2;
+                    continue;
+                }
+                if (c == in_string) {
+                    in_string = 0;
+                }
+            } else if (c == '"' || c == '\'') {
+                in_string = c;
+            }
+        }
+        i++;
+    }
+
+    return in_comment;
+}
+
+// editorSyntaxPrepass で 1 スレッドが受け持つ範囲
+typedef struct {
+    editorConfig *E;
+    int from;
+    int to;
+    // 各行の開始状態。bit 0 は範囲の入口がコメント外、bit 1 はコメント中だった場合
+    unsigned char *starts;
+    // 範囲の出口での状態 (入口がコメント外 / コメント中だった場合)
+    int exit[2];
+} editorPrepassChunk;
+
+void *editorSyntaxPrepassWorker(void *arg) {
+    editorPrepassChunk *chunk = arg;
+    editorConfig *E = chunk->E;
+    traceSetThreadName("prepass");
+    TRACE_BEGIN(span);
+    int state[2] = {0, 1};
+    bool converged = false;
+
+    for (int at = chunk->from; at < chunk->to; at++) {
+        chunk->starts[at] = state[0] | (state[1] << 1);
+        state[0] = editorSyntaxScanState(E, &E->row[at], state[0]);
+        if (converged) {
+            state[1] = state[0];
+        } else {
+            state[1] = editorSyntaxScanState(E, &E->row[at], state[1]);
+            // 一度同じ状態になれば、それ以降は入口の状態によらず同じになる
+            converged = (state[0] == state[1]);
+        }
+    }
+    chunk->exit[0] = state[0];
+    chunk->exit[1] = state[1];
+    TRACE_END("prepass chunk", span);
+    return NULL;
+}
+
+/// 開いたファイルの全ての行の開始状態を並列に求める関数
+// ファイルを分割し、各範囲について入口がコメント外とコメント中の両方の場合を同時に計算しておき、
+// 最後に先頭から範囲の出口の状態を繋いで、それぞれの行がどちらの結果を使うか決める。
+// hl そのものは作らず、描画する時に editorSyntaxUpdateRange が作る。
+void editorSyntaxPrepass(editorConfig *E) {
+    if (E->numrows == 0) {
+        return;
+    }
+    if (E->syntax == NULL) {
+        for (int at = 0; at < E->numrows; at++) {
+            E->row[at].hl_start = 0;
+            E->row[at].hl_open_comment = 0;
+            E->row[at].hl_dirty = false;
+            E->row[at].hl_pending = true;
+        }
+        E->hl_frontier = E->numrows;
+        return;
+    }
+    if (E->numrows < KEDITOR_HL_PREPASS_MIN_ROWS) {
+        return;
+    }
+    // 圧縮した行を読むと共有のキャッシュを書き換えるので、その時は並列に走査しない
+    for (int at = 0; at < E->numrows; at++) {
+        if (E->row[at].cold) {
+            return;
+        }
+    }
+    TRACE_BEGIN(span);
+
+    int nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads < 1) {
+        nthreads = 1;
+    }
+    if (nthreads > KEDITOR_HL_PREPASS_MAX_THREADS) {
+        nthreads = KEDITOR_HL_PREPASS_MAX_THREADS;
+    }
+
+    unsigned char *starts = editorMalloc(MEM_SCRATCH, sizeof(unsigned char) * E->numrows);
+    if (starts == NULL) {
+        return;
+    }
+    editorPrepassChunk chunks[KEDITOR_HL_PREPASS_MAX_THREADS];
+    pthread_t threads[KEDITOR_HL_PREPASS_MAX_THREADS];
+    bool started[KEDITOR_HL_PREPASS_MAX_THREADS];
+
+    int per_chunk = (E->numrows + nthreads - 1) / nthreads;
+    for (int t = 0; t < nthreads; t++) {
+        chunks[t].from = t * per_chunk;
+        chunks[t].to = (t + 1) * per_chunk;
+        if (chunks[t].from > E->numrows) {
+            chunks[t].from = E->numrows;
+        }
+        if (chunks[t].to > E->numrows) {
+            chunks[t].to = E->numrows;
+        }
+        chunks[t].E = E;
+        chunks[t].starts = starts;
+        // スレッドを作れなかった範囲はここで計算する
+        started[t] = pthread_create(&threads[t], NULL, editorSyntaxPrepassWorker, &chunks[t]) == 0;
+        if (!started[t]) {
+            editorSyntaxPrepassWorker(&chunks[t]);
+        }
+    }
+
+    int entry = 0;
+    for (int t = 0; t < nthreads; t++) {
+        if (started[t]) {
+            pthread_join(threads[t], NULL);
+        }
+        for (int at = chunks[t].from; at < chunks[t].to; at++) {
+            erow *row = &E->row[at];
+            row->hl_start = (starts[at] >> entry) & 1;
+            if (at > 0) {
+                E->row[at - 1].hl_open_comment = row->hl_start;
+            }
+            row->hl_dirty = false;
+            row->hl_pending = true;
+        }
+        entry = chunks[t].exit[entry];
+    }
+    E->row[E->numrows - 1].hl_open_comment = entry;
+    E->hl_frontier = E->numrows;
+
+    editorMemFree(starts);
+    TRACE_END("prepass", span);
+}
+
+/// キー入力を待っている間に、画面外の行のハイライトを一定量だけ進める関数
+void editorSyntaxIdle(editorConfig *E) {
+    if (E->hl_frontier < E->numrows) {
+        TRACE_BEGIN(span);
+        editorSyntaxUpdateUntil(E, E->hl_frontier + KEDITOR_HL_IDLE_ROWS);
+        TRACE_END("syntax idle", span);
+    }
+}
+
+/// 端末の色の種類を調べて、ハイライトの種類ごとのエスケープシーケンスを作っておく関数
+// KEDITOR_COLORS (16 / 256 / truecolor) で明示でき、無ければ COLORTERM と TERM から判断する。
+void editorInitColors() {
+    int mode = COLOR_MODE_16;
+    char *colors = getenv("KEDITOR_COLORS");
+    char *colorterm = getenv("COLORTERM");
+    char *term = getenv("TERM");
+    if (colors) {
+        if (!strcmp(colors, "truecolor")) {
+            mode = COLOR_MODE_TRUECOLOR;
+        } else if (!strcmp(colors, "256")) {
+            mode = COLOR_MODE_256;
+        }
+    } else if (colorterm && (!strcmp(colorterm, "truecolor") || !strcmp(colorterm, "24bit"))) {
+        mode = COLOR_MODE_TRUECOLOR;
+    } else if (term && strstr(term, "256color")) {
+        mode = COLOR_MODE_256;
+    }
+
+    for (int hl = 0; hl < HL_MAX; hl++) {
+        editorColor *color = &HL_COLORS[hl];
+        char buf[32];
+        int len;
+        if (color->index256 < 0 || mode == COLOR_MODE_16) {
+            len = snprintf(buf, sizeof(buf), "\x1b[%dm", color->basic);
+        } else if (mode == COLOR_MODE_256) {
+            len = snprintf(buf, sizeof(buf), "\x1b[38;5;%dm", color->index256);
+        } else {
+            len = snprintf(buf, sizeof(buf), "\x1b[38;2;%d;%d;%dm", color->r, color->g, color->b);
+        }
+
+        hl_sgr[hl] = NULL;
+        for (int prev = 0; prev < hl; prev++) {
+            if (hl_sgr_len[prev] == len && !memcmp(hl_sgr[prev], buf, len)) {
+                hl_sgr[hl] = hl_sgr[prev];
+                break;
+            }
+        }
+        if (hl_sgr[hl] == NULL) {
+            hl_sgr[hl] = strdup(buf);
+        }
+        hl_sgr_len[hl] = len;
+    }
+}
+
+/// 色が実際に変わる時だけエスケープシーケンスを書き込む関数
+void editorSetColor(abuf *ab, int *current, int hl) {
+    if (hl_sgr[*current] == hl_sgr[hl]) {
+        return;
+    }
+    abAppend(ab, hl_sgr[hl], hl_sgr_len[hl]);
+    *current = hl;
+}
+
+/// ファイル名の拡張子からハイライトの設定を選ぶ関数
+void editorSelectSyntaxHighlight(editorConfig *E) {
+    E->syntax = NULL;
+    if (E->filename == NULL) {
+        return;
+    }
+
+    char *ext = strrchr(E->filename, '.');
+
+    for (unsigned int j = 0; j < HLDB_ENTRIES; j++) {
+        editorSyntax *s = &HLDB[j];
+        unsigned int i = 0;
+        while (s->filematch[i]) {
+            int is_ext = (s->filematch[i][0] == '.');
+            if ((is_ext && ext && !strcmp(ext, s->filematch[i])) ||
+                (!is_ext && strstr(E->filename, s->filematch[i]))) {
+                E->syntax = s;
+                break;
+            }
+            i++;
+        }
+        if (E->syntax) {
+            break;
+        }
+    }
+
+    // 設定が変わったので全ての行を計算し直す
+    for (int at = 0; at < E->numrows; at++) {
+        E->row[at].hl_dirty = true;
+        E->row[at].hl_pending = false;
+    }
+    editorInvalidateSyntax(E, 0);
+}
+
+/* Row Operations */
+
+// 文字を挿入する関数
+void editorRowInsertChar(editorConfig *E, erow *row, int at, int c) {
+    if (at < 0 || at > row->size) {
+        at = row->size;
+    }
+    char *chars = editorRowReserve(row, row->size + 1);
+    memmove(&chars[at + 1], &chars[at], row->size - at + 1);
+    chars[at] = c;
+    row->size++;
+    editorAnchorSpliceCols(E, row - E->row, at, 0, 1);
+    editorUpdateRow(E, row);
+    E->dirty++;
+}
+
+// 文字を削除刷る関数
+void editorRowDeleteChar(editorConfig *E, erow *row, int at) {
+    if (at < 0 || at > row->size) {
+        return;
+    }
+    editorRowDetach(row);
+    char *chars = editorRowChars(row);
+    memmove(&chars[at], &chars[at + 1], row->size - at);
+    row->size--;
+    editorAnchorSpliceCols(E, row - E->row, at, 1, 0);
+    editorUpdateRow(E, row);
+    E->dirty++;
+}
+
+void editorFreeRow(erow *row) {
+    // アリーナの行は使っていた分をアリーナに返す (スラブは空になった時に解放される)
+    if (row->arena) {
+        if (!row->inline_text) {
+            editorArenaRelease(row->text.ptr, row->size + 1);
+        }
+        if (row->display) {
+            editorArenaRelease(row->display, editorRowDisplaySize(row));
+        }
+        return;
+    }
+    if (row->cold) {
+        editorColdRelease(row->text.cold_block);
+    } else if (!row->inline_text) {
+        editorMemFree(row->text.ptr);
+    }
+    editorMemFree(row->display);
+}
+
+void editorDeleteRow(editorConfig *E, int at) {
+    if (at < 0 || at >= E->numrows) {
+        return;
+    }
+    editorLoadRows(E, at, at + 1);
+    editorFreeRow(&E->row[at]);
+    memmove(&E->row[at], &E->row[at + 1], sizeof(erow) * (E->numrows - at - 1));
+    E->numrows--;
+    editorInvalidateSyntax(E, at);
+    editorDamage(E, at, INT_MAX);
+    editorFilterSplice(E, at, 1, 0);
+    editorFoldSplice(E, at, 1, 0);
+    editorAnchorSplice(E, at, 1, 0);
+    editorTailSplice(E, at, 1, 0);
+    editorLoadSplice(E, at, 1, 0);
+    E->dirty++;
+}
+
+void editorRowAppendString(editorConfig *E, erow *row, char *s, size_t len) {
+    char *chars = editorRowReserve(row, row->size + len);
+    memcpy(&chars[row->size], s, len);
+    row->size += len;
+    chars[row->size] = '\0';
+    editorUpdateRow(E, row);
+    E->dirty++;
+}
+
+/// スラブを 1 つ確保する関数
+// スラブの大きさに揃えて確保するので、editorMalloc は使わずに分類ごとの使用量を直接数える。
+editorArena *editorArenaSlabNew() {
+    void *p;
+    if (posix_memalign(&p, KEDITOR_ARENA_SLAB_SIZE, KEDITOR_ARENA_SLAB_SIZE) != 0) {
+        return NULL;
+    }
+    PERF_COUNT(editor_allocs);
+#ifdef KEDITOR_MEM_ACCOUNT
+    editor_mem[MEM_ARENA].allocs++;
+    editorMemAccount(MEM_ARENA, KEDITOR_ARENA_SLAB_SIZE, 1, 0);
+#endif
+    editorArena *slab = p;
+    slab->next = NULL;
+    slab->prev = NULL;
+    slab->used = 0;
+    slab->size = KEDITOR_ARENA_SLAB_SIZE - sizeof(editorArena);
+    slab->live = 0;
+    slab->pinned = false;
+    return slab;
+}
+
+void editorArenaSlabFree(editorArena *slab) {
+#ifdef KEDITOR_MEM_ACCOUNT
+    editorMemAccount(MEM_ARENA, -KEDITOR_ARENA_SLAB_SIZE, -1, 0);
+#endif
+    free(slab);
+}
+
+/// 使い終わったスラブをアリーナから外して解放する関数
+void editorArenaSlabUnlink(editorArena *slab) {
+    slab->prev->next = slab->next;
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    editorArenaSlabFree(slab);
+}
+
+/// アリーナから切り出した領域 ptr が属するスラブを返す関数
+editorArena *editorArenaSlabOf(void *ptr) {
+    return (editorArena *) ((uintptr_t) ptr & ~((uintptr_t) KEDITOR_ARENA_SLAB_SIZE - 1));
+}
+
+/// アリーナから size バイト切り出す関数
+// 今のスラブに入らなければ新しいスラブを先頭に足す。
+// 切り出すのは KEDITOR_ARENA_MAX_ROW 以下の行の分だけなので、スラブの 1/4 を超えることは無い。
+void *editorArenaAlloc(editorConfig *E, size_t size) {
+    editorArena *slab = E->arena;
+    if (slab == NULL || slab->size - slab->used < size) {
+        slab = editorArenaSlabNew();
+        slab->next = E->arena;
+        if (E->arena) {
+            E->arena->prev = slab;
+        }
+        E->arena = slab;
+    }
+    void *p = &slab->data[slab->used];
+    slab->used += size;
+    slab->live += size;
+    return p;
+}
+
+/// アリーナから切り出した size バイトを使い終わった時に呼ぶ関数
+// スラブの中の領域は使い回さず、スラブの全てが使い終わったらスラブごと解放する。
+// 先頭のスラブはまだ切り出している途中なので解放しない。
+void editorArenaRelease(void *ptr, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    editorArena *slab = editorArenaSlabOf(ptr);
+    slab->live -= size;
+    if (slab->live == 0 && slab->prev != NULL && !slab->pinned) {
+        editorArenaSlabUnlink(slab);
+    }
+}
+
+/// 文字列 s を終端の '\0' 付きでアリーナに写し、その先頭を返す関数
+// 行の重複をまとめている間 (E->intern) は、同じ内容の文字列が既にあればそれを返して共有する。
+// 共有している文字列は書き換えず、編集する時は editorRowDetach で行ごとの領域に写す (copy-on-write)。
+char *editorArenaText(editorConfig *E, char *s, size_t len) {
+    editorIntern *intern = E->intern;
+    editorInternSlot *slot = NULL;
+    unsigned int hash = 0;
+    if (intern) {
+        hash = editorKeywordHash(s, len, 0);
+        unsigned int i = hash & intern->mask;
+        while (intern->slots[i].chars) {
+            slot = &intern->slots[i];
+            if (slot->hash == hash && slot->len == (int) len && !memcmp(slot->chars, s, len)) {
+                // 共有している行も、それぞれが解放する時に editorArenaRelease で返す
+                editorArenaSlabOf(slot->chars)->live += len + 1;
+                editor_mem_shared += len + 1;
+                return slot->chars;
+            }
+            i = (i + 1) & intern->mask;
+        }
+        slot = &intern->slots[i];
+    }
+
+    char *chars = editorArenaAlloc(E, len + 1);
+    memcpy(chars, s, len);
+    chars[len] = '\0';
+
+    if (slot) {
+        slot->chars = chars;
+        slot->len = len;
+        slot->hash = hash;
+        // 読み込んでいる間に編集されて live が 0 になっても、表から指している文字列を解放しない
+        editorArenaSlabOf(chars)->pinned = true;
+        // 半分埋まったら広げる
+        if (++intern->count * 2 > intern->mask + 1) {
+            editorInternGrow(intern);
+        }
+    }
+    return chars;
+}
+
+/// 同じ内容の行の文字列を共有し始める関数
+void editorInternBegin(editorConfig *E) {
+    editorIntern *intern = editorMalloc(MEM_SCRATCH, sizeof(editorIntern));
+    intern->slots = editorMalloc(MEM_SCRATCH, sizeof(editorInternSlot) * KEDITOR_INTERN_INITIAL_SIZE);
+    memset(intern->slots, 0, sizeof(editorInternSlot) * KEDITOR_INTERN_INITIAL_SIZE);
+    intern->mask = KEDITOR_INTERN_INITIAL_SIZE - 1;
+    intern->count = 0;
+    E->intern = intern;
+}
+
+/// 表を 2 倍の大きさに作り直す関数
+void editorInternGrow(editorIntern *intern) {
+    unsigned int size = (intern->mask + 1) * 2;
+    editorInternSlot *slots = editorMalloc(MEM_SCRATCH, sizeof(editorInternSlot) * size);
+    memset(slots, 0, sizeof(editorInternSlot) * size);
+    for (unsigned int i = 0; i <= intern->mask; i++) {
+        editorInternSlot *old = &intern->slots[i];
+        if (old->chars == NULL) {
+            continue;
+        }
+        unsigned int j = old->hash & (size - 1);
+        while (slots[j].chars) {
+            j = (j + 1) & (size - 1);
+        }
+        slots[j] = *old;
+    }
+    editorMemFree(intern->slots);
+    intern->slots = slots;
+    intern->mask = size - 1;
+}
+
+/// 読み込みが終わった時に表を捨てる関数 (共有している文字列はそのまま残る)
+// 表が指していたために解放しなかったスラブは、使い終わっていればここで解放する。
+void editorInternEnd(editorConfig *E) {
+    if (E->intern == NULL) {
+        return;
+    }
+    editorMemFree(E->intern->slots);
+    editorMemFree(E->intern);
+    E->intern = NULL;
+
+    editorArena *slab = E->arena;
+    while (slab) {
+        editorArena *next = slab->next;
+        slab->pinned = false;
+        if (slab->live == 0 && slab->prev != NULL) {
+            editorArenaSlabUnlink(slab);
+        }
+        slab = next;
+    }
+}
+
+/// アリーナを全て解放する関数
+void editorArenaFree(editorConfig *E) {
+    editorArena *slab = E->arena;
+    while (slab) {
+        editorArena *next = slab->next;
+        editorArenaSlabFree(slab);
+        slab = next;
+    }
+    E->arena = NULL;
+}
+
+/// アリーナの行と圧縮した行を、行ごとに確保した領域に移す関数
+// 行の文字列を書き換える前に呼ぶ。アリーナの中の元の領域は editorArenaRelease で返す。
+void editorRowDetach(erow *row) {
+    if (row->cold) {
+        editorColdBlock *block = row->text.cold_block;
+        char *chars = editorMalloc(MEM_TEXT, row->size + 1);
+        memcpy(chars, editorColdChars(row), row->size + 1);
+        row->text.ptr = chars;
+        row->cold = false;
+        editorColdRelease(block);
+        return;
+    }
+    if (!row->arena) {
+        return;
+    }
+    if (!row->inline_text) {
+        char *chars = editorMalloc(MEM_TEXT, row->size + 1);
+        memcpy(chars, row->text.ptr, row->size + 1);
+        editorArenaRelease(row->text.ptr, row->size + 1);
+        row->text.ptr = chars;
+    }
+    if (row->display) {
+        size_t size = editorRowDisplaySize(row);
+        void *display = editorMalloc(row->tabs ? MEM_RENDER : MEM_HL, size);
+        memcpy(display, row->display, size);
+        editorArenaRelease(row->display, size);
+        row->display = display;
+    }
+    row->arena = false;
+}
+
+/// 行の文字列に size 文字 (と終端の '\0') を書き込めるようにして、その先頭を返す関数
+// アリーナの行は行ごとの領域に移し、text.buf に収まらなくなった行は text.ptr に移す。
+char *editorRowReserve(erow *row, int size) {
+    editorRowDetach(row);
+    if (row->inline_text) {
+        if (size < KEDITOR_ROW_INLINE) {
+            return row->text.buf;
+        }
+        char *chars = editorMalloc(MEM_TEXT, size + 1);
+        memcpy(chars, row->text.buf, row->size + 1);
+        row->text.ptr = chars;
+        row->inline_text = false;
+        return chars;
+    }
+    row->text.ptr = editorRealloc(MEM_TEXT, row->text.ptr, size + 1);
+    return row->text.ptr;
+}
+
+/// 行の表示用のデータ (render, hl) を捨てる関数
+// 次に描画する時に editorSyntaxUpdateRange が作り直す。
+// アリーナの行は、文字列を erow の中か圧縮ブロックに移してから呼ぶ (行はアリーナの外に出る)。
+void editorRowDropDisplay(erow *row) {
+    if (row->display) {
+        if (row->arena) {
+            editorArenaRelease(row->display, editorRowDisplaySize(row));
+        } else {
+            editorMemFree(row->display);
+        }
+        row->display = NULL;
+    }
+    row->arena = false;
+    if (!row->hl_dirty) {
+        row->hl_pending = true;
+    }
+}
+
+/// 圧縮した行の文字列を返す関数
+// ブロックがキャッシュに無ければ展開する。返した文字列は、別のブロックを
+// KEDITOR_COLD_CACHE_BLOCKS 個読むまで (キャッシュから追い出されるまで) 使える。
+char *editorColdChars(erow *row) {
+    editorColdBlock *block = row->text.cold_block;
+    if (block->raw == NULL) {
+        editorColdLoad(block);
+    }
+    block->used = ++cold_clock;
+    return block->raw + row->cold_offset;
+}
+
+/// ブロックを展開してキャッシュに入れる関数
+// 空きが無ければ、最も長く読まれていないブロックの展開したデータを捨てる。
+void editorColdLoad(editorColdBlock *block) {
+    TRACE_BEGIN(span);
+    int slot = 0;
+    for (int i = 0; i < KEDITOR_COLD_CACHE_BLOCKS; i++) {
+        if (cold_cache[i] == NULL) {
+            slot = i;
+            break;
+        }
+        if (cold_cache[i]->used < cold_cache[slot]->used) {
+            slot = i;
+        }
+    }
+    if (cold_cache[slot]) {
+        editorMemFree(cold_cache[slot]->raw);
+        cold_cache[slot]->raw = NULL;
+    }
+
+    block->raw = editorMalloc(MEM_CACHE, block->raw_size);
+    lzDecompress(block->data, block->size, block->raw, block->raw_size);
+    cold_cache[slot] = block;
+    TRACE_END("cold load", span);
+}
+
+/// ブロックを指している行が 1 つ減った時に呼ぶ関数 (どの行も指さなくなれば解放する)
+void editorColdRelease(editorColdBlock *block) {
+    if (--block->refs > 0) {
+        return;
+    }
+    for (int i = 0; i < KEDITOR_COLD_CACHE_BLOCKS; i++) {
+        if (cold_cache[i] == block) {
+            cold_cache[i] = NULL;
+        }
+    }
+    editorMemFree(block->raw);
+    editorMemFree(block->data);
+    editorMemFree(block);
+}
+
+/// rows に並べた nrows 行の文字列 (raw に rawlen バイト並べたもの) を圧縮して、1 つのブロックに移す関数
+void editorColdFlush(editorConfig *E, char *raw, int rawlen, int *rows, int nrows) {
+    int cap = LZ_BOUND(rawlen);
+    char *packed = editorMalloc(MEM_SCRATCH, cap);
+    int size = lzCompress(raw, rawlen, packed, cap);
+    if (size < 0) {
+        editorMemFree(packed);
+        return;
+    }
+
+    editorColdBlock *block = editorMalloc(MEM_COLD, sizeof(editorColdBlock));
+    block->data = editorMalloc(MEM_COLD, size);
+    memcpy(block->data, packed, size);
+    editorMemFree(packed);
+    block->size = size;
+    block->raw_size = rawlen;
+    block->raw = NULL;
+    block->used = 0;
+    block->refs = nrows;
+
+    int offset = 0;
+    for (int i = 0; i < nrows; i++) {
+        erow *row = &E->row[rows[i]];
+        if (row->arena) {
+            editorArenaRelease(row->text.ptr, row->size + 1);
+        } else {
+            editorMemFree(row->text.ptr);
+        }
+        editorRowDropDisplay(row);
+        row->text.cold_block = block;
+        row->cold_offset = offset;
+        row->cold = true;
+        offset += row->size + 1;
+    }
+}
+
+/// アイドル時に、画面から離れた行を圧縮する関数
+// 画面の上下 KEDITOR_COLD_MARGIN 行より外の行を、E->cold_cursor から一定数だけ調べる。
+// 文字列を erow の外に持つ行は、文字列を KEDITOR_COLD_BLOCK_SIZE ごとにまとめて圧縮する。
+// それ以外の行 (短い行とブロックより長い行) も、表示用のデータ (render, hl) は捨てる。
+void editorColdIdle(editorConfig *E) {
+    if (E->numrows < KEDITOR_COLD_MIN_ROWS) {
+        return;
+    }
+    TRACE_BEGIN(span);
+    int cap = KEDITOR_COLD_BLOCK_SIZE;
+    char *raw = editorMalloc(MEM_SCRATCH, cap);
+    int rawlen = 0;
+    int *rows = editorMalloc(MEM_SCRATCH, sizeof(int) * KEDITOR_COLD_IDLE_ROWS);
+    int nrows = 0;
+
+    for (int n = 0; n < KEDITOR_COLD_IDLE_ROWS && n < E->numrows; n++) {
+        if (E->cold_cursor >= E->numrows) {
+            E->cold_cursor = 0;
+        }
+        int at = E->cold_cursor++;
+        // どのウィンドウの画面からも近い行は圧縮しない
+        if (editorWindowNear(E, at, KEDITOR_COLD_MARGIN)) {
+            continue;
+        }
+        erow *row = &E->row[at];
+        // ブロックより長い行は圧縮しない (ブロックの中の位置が erow の cold_offset に収まるようにする)
+        if (row->cold || row->inline_text || row->size + 1 > cap) {
+            editorRowDropDisplay(row);
+            continue;
+        }
+
+        int len = row->size + 1;
+        if (rawlen + len > cap) {
+            editorColdFlush(E, raw, rawlen, rows, nrows);
+            rawlen = 0;
+            nrows = 0;
+        }
+        memcpy(raw + rawlen, editorRowChars(row), len);
+        rawlen += len;
+        rows[nrows++] = at;
+    }
+    if (nrows > 0) {
+        editorColdFlush(E, raw, rawlen, rows, nrows);
+    }
+
+    editorMemFree(raw);
+    editorMemFree(rows);
+    TRACE_END("cold idle", span);
+}
+
+/* Editor Operations */
+
+// 文字の挿入とカーソルの移動
+void editorInsertChar(editorConfig *E, int c) {
+    if (E->cy ==  E->numrows) {
+        editorAppendRow(E, E->numrows, "", 0);
+    }
+    editorRowInsertChar(E, &E->row[E->cy], E->cx, c);
+    E->cx++;
+}
+
+// カーソルの右側にある文字を削除し、カーソルを移動する関数
+void editorDeleteChar(editorConfig *E) {
+    if (E->cy == E->numrows) {
+        return;
+    }
+    if (E->cx == 0 && E->cy == 0) {
+        return;
+    }
+
+    erow *row = &E->row[E->cy];
+    if (E->cx > 0) {
+        editorRowDeleteChar(E, row, E->cx - 1);
+        E->cx--;
+    } else {
+        E->cx = E->row[E->cy - 1].size;
+        editorRowAppendString(E, &E->row[E->cy - 1], editorRowChars(row), row->size);
+        // 連結した行の目印は、前の行の末尾に移してから行を消す
+        editorAnchorMove(E, E->cy, 0, E->cy - 1, E->cx);
+        editorDeleteRow(E, E->cy);
+        E->cy--;
+    }
+}
+
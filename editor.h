@@ -0,0 +1,702 @@
+// エディタの中核 (バッファ、カーソル、行の操作、描画内容の組み立て)
+// 端末の入出力には触らないので、端末のフロントエンド (main.c) 以外からも使える。
+#ifndef KEDITOR_EDITOR_H
+#define KEDITOR_EDITOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "sidecar.h"
+
+#define CTRL_KEY(value) ((value) & 0x1f)
+#define ABUF_INIT {NULL, 0}
+#define KEDITOR_VERSION "0.0.1"
+#define KEDITOR_TAB_STOP 8
+#define KEDITOR_QUIT_TIMES 2
+// アイドル時 (キー入力待ち) に一度にシンタックスハイライトを進める行数
+#define KEDITOR_HL_IDLE_ROWS 2000
+// この行数以上のファイルを開いた時は、コメントの状態を並列に先読みする
+#define KEDITOR_HL_PREPASS_MIN_ROWS 10000
+#define KEDITOR_HL_PREPASS_MAX_THREADS 16
+// ファイルから読み込んだ行をまとめて確保する領域 (アリーナ) の 1 ブロックの大きさ (2 のべき乗)
+#define KEDITOR_ARENA_SLAB_SIZE (1 << 20)
+// この文字数より長い行はアリーナに置かない (タブを展開した render と hl もスラブの 1/4 に収まる)
+#define KEDITOR_ARENA_MAX_ROW (KEDITOR_ARENA_SLAB_SIZE / 64)
+// この文字数未満の行は、文字列を erow の中に直接持つ (終端の '\0' を含めてこの大きさに収まる)
+#define KEDITOR_ROW_INLINE 8
+// 行の重複をまとめる表の最初の大きさ (2 のべき乗)
+#define KEDITOR_INTERN_INITIAL_SIZE 1024
+// この行数以上のバッファでは、画面から離れた行をアイドル時に圧縮する (コールド行)
+#define KEDITOR_COLD_MIN_ROWS 100000
+// 画面の上下にこの行数だけは圧縮せずに残しておく
+#define KEDITOR_COLD_MARGIN 10000
+// 1 つの圧縮ブロックにまとめる文字列の大きさ
+#define KEDITOR_COLD_BLOCK_SIZE (64 * 1024)
+// アイドル時に一度に調べる行数
+#define KEDITOR_COLD_IDLE_ROWS 50000
+// 展開したまま持っておくブロックの数 (全てのバッファで共有する)
+#define KEDITOR_COLD_CACHE_BLOCKS 32
+// 追記された分を一度に読み込む大きさの目安 (行の途中では切らない)
+#define KEDITOR_FOLLOW_READ_BYTES (8 << 20)
+// ファイルを少しずつ読み込む時に、一度に読み込む大きさの目安 (行の途中では切らない)
+#define KEDITOR_LOAD_STEP_BYTES (4 << 20)
+// 他のプロセスが書き換えたファイルを読み込み直す時に、行単位の差分を探す編集数の上限
+// (超えた時は、先頭と末尾の共通部分の間をまとめて置き換える)
+#define KEDITOR_RELOAD_MAX_EDITS 1000
+// 表示する行を絞り込む時に、この行数以上のバッファでは一致する行を並列に探す
+#define KEDITOR_FILTER_PARALLEL_MIN_ROWS 100000
+#define KEDITOR_FILTER_MAX_THREADS 16
+
+#define HL_HIGHLIGHT_NUMBERS (1 << 0)
+#define HL_HIGHLIGHT_STRINGS (1 << 1)
+
+typedef struct editorConfig editorConfig;
+typedef struct abuf abuf;
+typedef struct erow erow;
+typedef struct editorSyntax editorSyntax;
+typedef struct editorKeyword editorKeyword;
+typedef struct editorPerf editorPerf;
+typedef struct editorMemStats editorMemStats;
+typedef struct editorArena editorArena;
+typedef struct editorIntern editorIntern;
+typedef struct editorColdBlock editorColdBlock;
+typedef struct editorFileStamp editorFileStamp;
+typedef struct editorLoad editorLoad;
+typedef struct editorWindow editorWindow;
+typedef struct editorFilter editorFilter;
+typedef struct editorFold editorFold;
+typedef struct editorAnchor editorAnchor;
+
+// 1 行分のデータ。行の数だけ並ぶので、なるべく小さくしている (64 bit 環境で 24 バイト。元は 32 バイト)。
+// 文字列と表示用のデータには直接触らず、editorRowChars, editorRowRender, editorRowHl, editorRowRsize を通して読む。
+// タブを展開した表示用の文字数 (rsize) は、タブを含まない行では size と同じなので持たず、
+// タブを含む行では display の先頭に持つ。
+struct erow {
+    // 文字数
+    int size;
+    // hl を計算した時の開始状態 (前の行からブロックコメントが続いているか)
+    unsigned int hl_start : 1;
+    // 行末でブロックコメントが閉じていないか (次の行の開始状態になる)
+    unsigned int hl_open_comment : 1;
+    // 内容が変わって hl を計算し直す必要があるか
+    unsigned int hl_dirty : 1;
+    // hl_start と hl_open_comment は確定しているが、hl はまだ作っていないか (先読みした行)
+    unsigned int hl_pending : 1;
+    // text.ptr と display がアリーナの中にあるか (ファイルから読み込んだまま編集していない行)
+    unsigned int arena : 1;
+    // 文字列を text.buf に持っているか
+    unsigned int inline_text : 1;
+    // タブを含み、display に render を持っているか
+    unsigned int tabs : 1;
+    // 文字列を圧縮したブロックに移してあるか (display は行ごとに確保した領域か NULL)
+    unsigned int cold : 1;
+    // 圧縮したブロックの中の文字列の位置 (ブロックは KEDITOR_COLD_BLOCK_SIZE 以下なので 24 bit に収まる)
+    unsigned int cold_offset : 24;
+    // 文字列。短い行 (inline_text) は buf に直接持ち、圧縮した行 (cold) は cold_block の cold_offset の位置に、
+    // それ以外は ptr の先に持つ。
+    union {
+        char *ptr;
+        char buf[KEDITOR_ROW_INLINE];
+        editorColdBlock *cold_block;
+    } text;
+    // 表示用のデータ。タブを含む行 (tabs) は rsize (int) と render (rsize + 1 バイト) と hl (rsize バイト) を
+    // 続けて持ち、タブを含まない行は render が文字列と同じなので hl だけを持つ (hl は描画するまで作らない)。
+    // 圧縮した時に捨てるので、タブを含む行でも NULL のことがある。
+    void *display;
+};
+
+char *editorColdChars(erow *row);
+int editorRowMeasure(erow *row);
+
+static inline char *editorRowChars(erow *row) {
+    if (row->inline_text) {
+        return row->text.buf;
+    }
+    return row->cold ? editorColdChars(row) : row->text.ptr;
+}
+
+/// タブを展開した表示用の文字数を返す関数 (display を捨てたタブを含む行は数え直す)
+static inline int editorRowRsize(erow *row) {
+    if (!row->tabs) {
+        return row->size;
+    }
+    if (row->display == NULL) {
+        return editorRowMeasure(row);
+    }
+    // アリーナの中の display は揃っていないことがあるので memcpy で読む
+    int rsize;
+    memcpy(&rsize, row->display, sizeof(rsize));
+    return rsize;
+}
+
+static inline char *editorRowRender(erow *row) {
+    return row->tabs ? (char *) row->display + sizeof(int) : editorRowChars(row);
+}
+
+static inline unsigned char *editorRowHl(erow *row) {
+    if (!row->tabs) {
+        return (unsigned char *) row->display;
+    }
+    return (unsigned char *) row->display + sizeof(int) + editorRowRsize(row) + 1;
+}
+
+static inline size_t editorRowDisplaySize(erow *row) {
+    int rsize = editorRowRsize(row);
+    return row->tabs ? sizeof(int) + (size_t) rsize * 2 + 1 : (size_t) rsize;
+}
+
+// ファイルから読み込んだ行の文字列をまとめて確保する領域。
+// 行ごとに malloc せずに大きなブロック (スラブ) から切り出す。
+// スラブは自分の大きさに揃えて確保するので、切り出した領域のアドレスから属するスラブが分かる。
+// 使われているバイト数 (live) が 0 になったスラブは、その場で解放する。
+struct editorArena {
+    editorArena *next;
+    // 前のスラブ。先頭 (今切り出しているスラブ) は NULL
+    editorArena *prev;
+    size_t used;
+    size_t size;
+    size_t live;
+    // 行の重複をまとめる表 (E->intern) が中の文字列を指しているか。
+    // 指している間は live が 0 になっても解放せず、表を捨てる時 (editorInternEnd) に解放する。
+    bool pinned;
+    char data[];
+};
+
+// 画面から離れた行の文字列をまとめて圧縮したもの。
+// 読む時は展開したものを共有のキャッシュに置き、キャッシュが一杯なら最も古いものを捨てる。
+struct editorColdBlock {
+    // 圧縮したデータと、その大きさ
+    char *data;
+    int size;
+    // 展開した大きさ (各行の文字列を終端の '\0' 付きで並べたもの)
+    int raw_size;
+    // 展開したデータ (キャッシュに無ければ NULL) と、最後に読んだ順番
+    char *raw;
+    unsigned long used;
+    // このブロックを指している行の数
+    int refs;
+};
+
+// 読み込み中に、同じ内容の行の文字列を 1 つにまとめるための表 (開番地法のハッシュ表)
+typedef struct {
+    char *chars;
+    int len;
+    unsigned int hash;
+} editorInternSlot;
+
+struct editorIntern {
+    editorInternSlot *slots;
+    unsigned int mask;
+    unsigned int count;
+};
+
+// キーワードの完全ハッシュ表の 1 エントリ
+struct editorKeyword {
+    char *name;
+    int len;
+    unsigned char hl;
+};
+
+struct editorSyntax {
+    char *filetype;
+    char **filematch;
+    char **keywords;
+    char *singleline_comment_start;
+    char *multiline_comment_start;
+    char *multiline_comment_end;
+    int flags;
+    // keywords から起動時に作る完全ハッシュ表 (衝突しない seed を探して作る)
+    editorKeyword *kw_table;
+    unsigned int kw_mask;
+    unsigned int kw_seed;
+    int kw_maxlen;
+};
+
+// 性能の計測結果。Ctrl-P でメッセージバーに表示する。
+// 計測は KEDITOR_PERF を定義してビルドした時だけ行い、定義しなければ計測のコードごと消える。
+struct editorPerf {
+    bool visible;
+    // Ctrl-T でテキストの代わりにメモリの使用量の表を表示しているか
+    bool mem_visible;
+    // 直前のキーの処理、フレームの組み立て、書き込みにかかった時間
+    double key_ms;
+    double render_ms;
+    double write_ms;
+    // 直前のフレームの出力バイト数と、描画したファイルの行数
+    int frame_bytes;
+    int rows_drawn;
+    // 直前のフレームまでの間にハイライトし直した行数 (hl_count は集計中の値)
+    int rows_highlighted;
+    int hl_count;
+    // 直前のフレームまでの間のメモリ確保の回数 (alloc_mark は前回の editor_allocs)
+    long allocs;
+    long alloc_mark;
+    long rss_kb;
+    // 読まれずに残っている入力のバイト数
+    int input_queue;
+};
+
+// editorMalloc で確保するメモリの分類
+enum editorMemCategory {
+    // erow の配列 (行のヘッダ)
+    MEM_ROWS = 0,
+    // 行の文字列 (chars)
+    MEM_TEXT,
+    // タブを展開した表示用の文字列 (render)
+    MEM_RENDER,
+    // ハイライト (hl)
+    MEM_HL,
+    // 画面の出力 (abuf)
+    MEM_FRAME,
+    // 保存やハイライトの先読みで一時的に使う領域
+    MEM_SCRATCH,
+    // ファイルから読み込んだ行のアリーナ
+    MEM_ARENA,
+    // 圧縮した行のブロック
+    MEM_COLD,
+    // 展開した圧縮ブロックのキャッシュ
+    MEM_CACHE,
+    MEM_MAX,
+};
+
+// 分類ごとのメモリの使用量 (KEDITOR_PERF の時だけ数える)
+struct editorMemStats {
+    // 使っているバイト数 (要求した大きさの合計) とブロックの数
+    long bytes;
+    long blocks;
+    // bytes の最大値
+    long peak;
+    // 確保 (realloc を含む) の回数
+    long allocs;
+};
+
+// 分類ごとのメモリの使用量は、計測 (KEDITOR_PERF) を有効にした上で KEDITOR_MEM_ACCOUNT を指定した時だけ数える
+#if defined(KEDITOR_MEM_ACCOUNT) && !defined(KEDITOR_PERF)
+#undef KEDITOR_MEM_ACCOUNT
+#endif
+
+#ifdef KEDITOR_PERF
+#define PERF_COUNT(counter) ((counter)++)
+#else
+#define PERF_COUNT(counter) ((void) 0)
+#endif
+
+// 最後に読み込んだ (保存した) 時のファイルの状態。他のプロセスが書き換えたかを比べるのに使う。
+struct editorFileStamp {
+    bool valid;
+    long size;
+    time_t mtime;
+    long mtime_nsec;
+    unsigned long ino;
+    // 所々を読んだ内容のハッシュ (大きさと更新時刻が同じまま書き換えられた時のため)
+    uint64_t sample;
+};
+
+// 少しずつ読み込んでいる途中のファイル (editorOpenBegin から最後まで読み込むまで)
+// 索引のキャッシュがあれば、開いた時に全ての行を空の仮の行として作っておき、
+// KEDITOR_SIDECAR_STRIDE 行ずつのブロックを、表示する所から行の位置に移動して読み込む (editorLoadRows)。
+// まだ読み込んでいないブロックの行は編集しない (前後に行を追加、削除する時は先に読み込む) ので、
+// ブロックの行は続いたまま、ブロックの先頭の行の番号だけが編集に合わせてずれる。
+struct editorLoad {
+    FILE *fp;
+    // ファイルの大きさと、読み込み終わったバイト数 (進み具合の表示に使う)
+    long size;
+    long pos;
+    // 読み込んだ行数 (読み込んでいる間に編集されても、ファイルの行数を数える)
+    int lines;
+    char *line;
+    size_t linecap;
+    // 索引のキャッシュを使う (書き出す) か、キーが一致するキャッシュがあるか
+    bool indexing;
+    bool hit;
+    sidecarIndex index;
+    // キャッシュが無い時に、読みながら覚えた行の位置の数と確保した数
+    int offsets_cap;
+    // 仮の行を作ってブロックごとに読み込んでいるか
+    bool stubs;
+    // キャッシュしておいたハイライトの状態を仮の行に戻したか (読み込んだ行にも戻す)
+    bool hl_cached;
+    // ブロックの先頭の今の行の番号と、読み込んだか (どちらも index.header.noffsets 個)
+    int *block_row;
+    bool *block_done;
+    // まだ読み込んでいないブロックの数と、キー入力を待つ間に次に読み込むブロック
+    int blocks_left;
+    int next_block;
+};
+
+// 文字列を含む行だけを表示する絞り込み (Ctrl-G)
+// 一致する行の番号を昇順に並べた索引を持ち、行の追加、削除、編集の度に直す。
+// カーソルと rowoff は実際の行の番号のままにして、描画、スクロール、カーソルの移動は
+// editorViewIndex と editorViewRow で索引を辿る。編集は実際の行に対して行う。
+struct editorFilter {
+    char *pattern;
+    int len;
+    // 一致する行の番号 (昇順)
+    int *rows;
+    int count;
+    int cap;
+    // パターンを含まなくてもカーソルがあるので表示している行 (無ければ -1)。カーソルが離れたら調べ直す。
+    int shown;
+};
+
+// 畳んだ範囲 (start 行目を見出しとして残し、start + 1 行目から end 行目までを隠す)。
+// 畳んだ範囲は互いに重ならないので、start の順に並べた平衡二分木 (treap) を区間木として使う。
+// 部分木で隠している行数の合計を持っておき、表示している行の位置と実際の行の番号の変換を O(log n) で行う。
+// 行の追加と削除で後ろの範囲をずらす分は、部分木の根にだけ書いておき (shift)、辿る時に子に伝える。
+struct editorFold {
+    editorFold *left;
+    editorFold *right;
+    unsigned int priority;
+    int start;
+    int end;
+    // 子の部分木にまだ足していない行数
+    int shift;
+    // 部分木で隠している行数の合計
+    int hidden;
+};
+
+// 位置の目印 (アンカー) の種類。種類ごとに別の木に入れ、次の (前の) 目印へは種類ごとに移る。
+enum editorAnchorKind {
+    // 名前 (a から z) を付けたマーク
+    ANCHOR_MARK = 0,
+    // 名前の無いブックマーク (行ごとに付け外しする)
+    ANCHOR_BOOKMARK,
+    // 検索で一致した位置と、診断 (エラーや警告) の位置。フロントエンドや外部のツールが付ける。
+    ANCHOR_SEARCH,
+    ANCHOR_DIAGNOSTIC,
+    ANCHOR_KINDS,
+};
+
+// 編集しても同じ文字を指し続ける位置の目印 (row 行目の col 文字目)
+// 種類ごとに位置の順に並べた treap に入れ、畳んだ範囲の木と同じく、行の追加と削除で後ろの目印をずらす分は
+// 部分木の根にだけ書いておく (shift)。名前で引いたマークの位置は、親を辿って shift を足して求める。
+struct editorAnchor {
+    editorAnchor *left;
+    editorAnchor *right;
+    editorAnchor *parent;
+    unsigned int priority;
+    int row;
+    int col;
+    // 子の部分木にまだ足していない行数
+    int shift;
+    // マークの名前 (名前が無ければ 0)
+    char name;
+};
+
+// 画面を分けた 1 つのウィンドウ。同じバッファの別の場所を、それぞれのカーソルとスクロールの位置で表示する。
+// 行と、行ごとの表示用のデータ (render, hl) は全てのウィンドウで共有する。
+struct editorWindow {
+    // 画面の中の位置 (0 始まり) と、テキストを表示する大きさ (その下にステータスバーが 1 行付く)
+    int top;
+    int left;
+    int rows;
+    int cols;
+    // カーソルとスクロールの位置 (入力を受け取っているウィンドウの分は editorConfig にあり、切り替える時に写す)
+    int cx;
+    int cy;
+    int rx;
+    int rowoff;
+    int coloff;
+    // 次のフレームで全ての行を書き直すか、前のフレームで書いた時のスクロールの位置
+    bool redraw;
+    int drawn_rowoff;
+    int drawn_coloff;
+};
+
+// エディタ 1 つ分の状態。関数は全てこれを引数で受け取る。
+struct editorConfig {
+    int screenrows;
+    int screencols;
+    int cx;
+    int cy;
+    int rx;
+    int numrows;
+    erow *row;
+    int rowoff;
+    int coloff;
+    char *filename;
+    char statusmsg[80];
+    time_t statusmsg_time;
+    int dirty;
+    // 未保存のまま終了するまでに残っている Ctrl-Q の回数
+    int quit_times;
+    editorSyntax *syntax;
+    // この行より前の行はハイライトが確定している。
+    // 編集があるとその行まで戻し、描画やアイドル時に少しずつ進める。
+    int hl_frontier;
+    // 読み込んだ行の文字列を切り出すアリーナ (先頭が今切り出しているスラブ)
+    editorArena *arena;
+    // ファイルを読み込む時に、同じ内容の行の文字列を共有するか (フロントエンドが設定する)
+    bool intern_lines;
+    // 読み込み中だけ使う、共有する文字列の表
+    editorIntern *intern;
+    // 少しずつ読み込んでいる途中のファイル (読み込んでいなければ NULL)
+    editorLoad *load;
+    // 大きなファイルの行の索引をキャッシュするディレクトリ (NULL ならキャッシュしない。フロントエンドが設定する)
+    char *cache_dir;
+    // 次に圧縮するかを調べる行 (アイドル時に少しずつ進める)
+    int cold_cursor;
+    // ファイルの中で読み込み終わった所 (最後の改行の次) と、
+    // その後ろの改行の無い部分を仮の行として読み込んだ行 (無ければ -1。編集されたら普通の行として扱い -1 にする)
+    long file_offset;
+    int file_tail;
+    // 追記された分を一度に読み切れず、続きが残っているか (フロントエンドがキー入力を待つ間に editorFollow を呼び直す)
+    bool follow_pending;
+    // 追記された行を読み込んだ時に、最後の行にいたカーソルを最後の行まで動かすか (フロントエンドが設定する)
+    bool follow_scroll;
+    editorFileStamp file_stamp;
+    // ディスク上で書き換えられたファイルへの上書きを、Ctrl-S をもう一度押して確かめたか
+    bool overwrite_confirmed;
+    // 画面を分けている時のウィンドウ (分けていなければ NULL と 0) と、入力を受け取っているウィンドウ。
+    // screenrows, screencols, cx, cy, rx, rowoff, coloff は入力を受け取っているウィンドウのもの。
+    editorWindow *windows;
+    int numwindows;
+    int window;
+    // Ctrl-W の次のキー (ウィンドウの操作) を待っているか
+    bool window_key;
+    // 表示する行の絞り込み (絞り込んでいなければ NULL)
+    editorFilter *filter;
+    // 畳んだ範囲の木 (無ければ NULL)。絞り込んでいる間は畳んだ範囲も含めて一致する行を表示する。
+    editorFold *folds;
+    // 範囲を指定して畳む時の始めの行 (指定していなければ -1) と、Ctrl-F の次のキー (畳む操作) を待っているか
+    int fold_mark;
+    bool fold_key;
+    // 位置の目印の木 (種類ごと) と、名前を付けたマーク (無ければ NULL)
+    editorAnchor *anchors[ANCHOR_KINDS];
+    editorAnchor *marks[26];
+    // Ctrl-K の次のキーを待っている時は 'k'、マークの名前を待っている時は 'm' (付ける) か '\'' (移る)。待っていなければ 0。
+    int mark_key;
+    // 前のフレームから表示が変わった行の範囲 (damage_from 行目から damage_to 行目の手前まで。行がずれた時は末尾まで)
+    int damage_from;
+    int damage_to;
+    editorPerf perf;
+};
+
+struct abuf {
+    char *buf;
+    int len;
+};
+
+enum editorKey {
+    BACKSPACE = 127,
+    ARROW_UP = 1000,
+    ARROW_RIGHT,
+    ARROW_DOWN,
+    ARROW_LEFT,
+    DELETE_KEY,
+    HOME_KEY,
+    END_KEY,
+    PAGE_UP,
+    PAGE_DOWN,
+};
+
+// editorProcessKey がフロントエンドに任せる処理
+enum editorAction {
+    EDITOR_ACTION_NONE = 0,
+    EDITOR_ACTION_QUIT,
+    EDITOR_ACTION_SAVE,
+    // 次の (前の) バッファに切り替える
+    EDITOR_ACTION_NEXT_BUFFER,
+    EDITOR_ACTION_PREV_BUFFER,
+    // 絞り込む文字列を入力させて、editorFilterSet を呼ぶ
+    EDITOR_ACTION_FILTER,
+};
+
+enum editorHighlight {
+    HL_NORMAL = 0,
+    HL_COMMENT,
+    HL_MLCOMMENT,
+    HL_KEYWORD1,
+    HL_KEYWORD2,
+    HL_STRING,
+    HL_NUMBER,
+    HL_MAX,
+};
+
+// 端末が扱える色の種類
+enum editorColorMode {
+    COLOR_MODE_16 = 0,
+    COLOR_MODE_256,
+    COLOR_MODE_TRUECOLOR,
+};
+
+// editor.c の中で行ったメモリ確保の回数 (KEDITOR_PERF の時だけ数える)
+extern long editor_allocs;
+extern editorMemStats editor_mem[MEM_MAX];
+// 管理用のヘッダと malloc の切り上げで、要求した大きさより余分に使っているバイト数
+extern long editor_mem_slack;
+// 読み込んだ時に、同じ内容の行と文字列を共有して確保せずに済んだバイト数
+extern long editor_mem_shared;
+
+/* Editor */
+void editorInit(editorConfig *E, int screenrows, int screencols);
+void editorFree(editorConfig *E);
+int editorDecodeKey(const char *seq, int len, int *used);
+int editorProcessKey(editorConfig *E, int c);
+void editorRevealCursor(editorConfig *E);
+void editorRenderFrame(editorConfig *E, abuf *ab);
+void editorIdle(editorConfig *E);
+void editorMoveCursor(editorConfig *E, int key);
+void editorScroll(editorConfig *E);
+void editorSetStatusMessage(editorConfig *E, const char *fmt, ...);
+void editorDrawRows(editorConfig *E, abuf *ab);
+void editorDrawStatusBar(editorConfig *E, abuf *ab);
+void editorDrawMessageBar(editorConfig *E, abuf *ab);
+void editorDrawWindowStatusBar(editorConfig *E, abuf *ab, bool focused);
+void editorDrawLineEnd(editorConfig *E, abuf *ab, int *current_hl, int width, bool right);
+void editorDamage(editorConfig *E, int from, int to);
+void abAppend(abuf *ab, char *s, int len);
+void abFree(abuf *ab);
+void *editorMalloc(int category, size_t size);
+void *editorRealloc(int category, void *ptr, size_t size);
+void editorMemFree(void *ptr);
+int editorMemFormatLine(int line, long rss_kb, char *buf, int size);
+void editorMemReport(FILE *fp, long rss_kb);
+double editorPerfNow();
+void editorPerfEndFrame(editorConfig *E);
+
+/* Windows */
+void editorRenderWindows(editorConfig *E, abuf *ab);
+void editorWindowCommand(editorConfig *E, int c);
+int editorWindowSplit(editorConfig *E, bool vertical);
+int editorWindowClose(editorConfig *E);
+void editorWindowOnly(editorConfig *E);
+void editorWindowSelect(editorConfig *E, int to);
+void editorWindowSave(editorConfig *E);
+void editorWindowLoad(editorConfig *E, int to);
+void editorWindowRedrawAll(editorConfig *E);
+void editorWindowArea(editorConfig *E, int *rows, int *cols);
+bool editorWindowNear(editorConfig *E, int at, int margin);
+
+/* Filter */
+int editorViewIndex(editorConfig *E, int at);
+int editorViewRow(editorConfig *E, int index);
+int editorFilterSet(editorConfig *E, char *pattern, int len);
+void editorFilterClear(editorConfig *E);
+int editorFilterFind(editorFilter *filter, int at);
+bool editorFilterMatch(editorFilter *filter, char *chars, int size);
+void editorFilterSplice(editorConfig *E, int at, int del, int ins);
+void editorFilterUpdateRow(editorConfig *E, int at);
+void editorFilterShow(editorConfig *E, int at);
+void editorFilterCursor(editorConfig *E);
+
+/* Folding */
+void editorFoldCommand(editorConfig *E, int c);
+int editorFoldIndent(erow *row);
+int editorFoldBraces(editorConfig *E, erow *row, bool *opened);
+int editorFoldDetect(editorConfig *E, int at, int *start, int *end);
+void editorFoldShift(editorFold *node, int delta);
+void editorFoldPush(editorFold *node);
+void editorFoldPull(editorFold *node);
+void editorFoldSplit(editorFold *node, int key, editorFold **left, editorFold **right);
+editorFold *editorFoldMerge(editorFold *left, editorFold *right);
+void editorFoldFreeTree(editorFold *node);
+editorFold *editorFoldLast(editorFold *node);
+void editorFoldSetLastEnd(editorFold *node, int end);
+void editorFoldAdd(editorConfig *E, int start, int end);
+bool editorFoldOpen(editorConfig *E, int at);
+void editorFoldOpenAll(editorConfig *E);
+editorFold *editorFoldFind(editorConfig *E, int at);
+int editorFoldHiddenBefore(editorConfig *E, int at);
+int editorFoldViewRow(editorConfig *E, int index);
+void editorFoldSplice(editorConfig *E, int at, int del, int ins);
+
+/* Anchors */
+void editorAnchorCommand(editorConfig *E, int pending, int c);
+bool editorAnchorLess(int row, int col, int key_row, int key_col);
+void editorAnchorShift(editorAnchor *node, int delta);
+void editorAnchorPush(editorAnchor *node);
+void editorAnchorPull(editorAnchor *node);
+void editorAnchorSplit(editorAnchor *node, int row, int col, editorAnchor **left, editorAnchor **right);
+editorAnchor *editorAnchorMerge(editorAnchor *left, editorAnchor *right);
+void editorAnchorFreeTree(editorConfig *E, editorAnchor *node);
+void editorAnchorSetRoot(editorConfig *E, int kind, editorAnchor *root);
+editorAnchor *editorAnchorAdd(editorConfig *E, int kind, int row, int col, char name);
+editorAnchor *editorAnchorDetach(editorAnchor *node, editorAnchor *target);
+void editorAnchorRemove(editorConfig *E, int kind, editorAnchor *node);
+void editorAnchorClear(editorConfig *E, int kind);
+void editorAnchorPosition(editorAnchor *node, int *row, int *col);
+editorAnchor *editorAnchorNext(editorConfig *E, int kind, int row, int col, bool forward);
+void editorAnchorJump(editorConfig *E, editorAnchor *node);
+void editorAnchorRebase(editorAnchor *node, int row, int base, int del, int ins, int to);
+void editorAnchorSplice(editorConfig *E, int at, int del, int ins);
+void editorAnchorSpliceCols(editorConfig *E, int at, int col, int del, int ins);
+void editorAnchorMove(editorConfig *E, int row, int col, int to_row, int to_col);
+
+/* File I/O */
+int editorOpen(editorConfig *E, char *filename);
+int editorOpenBegin(editorConfig *E, char *filename);
+int editorLoadStep(editorConfig *E, long bytes);
+void editorLoadUntil(editorConfig *E, int rows);
+void editorLoadStubs(editorConfig *E);
+void editorLoadRows(editorConfig *E, int from, int to);
+int editorLoadBlock(editorConfig *E, int k);
+void editorLoadSplice(editorConfig *E, int at, int del, int ins);
+void editorLoadFinish(editorConfig *E);
+void editorLoadEnd(editorConfig *E);
+void editorSetFilename(editorConfig *E, char *filename);
+// 返した領域は editorMemFree で解放する
+char *editorRowsToString(editorConfig *E, int *buflen);
+int editorSave(editorConfig *E);
+int editorFollow(editorConfig *E);
+void editorTailSplice(editorConfig *E, int at, int del, int ins);
+void editorStampFile(editorConfig *E);
+bool editorFileChanged(editorConfig *E);
+int editorReload(editorConfig *E);
+
+/* Row Operations */
+void editorAppendRow(editorConfig *E, int at, char *s, size_t len);
+void editorLoadRow(editorConfig *E, char *s, size_t len);
+void editorInsertRow(editorConfig *E, int at, char *s, size_t len, bool arena);
+void editorRowInit(editorConfig *E, erow *row, char *s, size_t len, bool arena);
+void *editorArenaAlloc(editorConfig *E, size_t size);
+char *editorArenaText(editorConfig *E, char *s, size_t len);
+void editorInternBegin(editorConfig *E);
+void editorInternGrow(editorIntern *intern);
+void editorInternEnd(editorConfig *E);
+void editorArenaRelease(void *ptr, size_t size);
+void editorArenaFree(editorConfig *E);
+void editorRowDetach(erow *row);
+char *editorRowReserve(erow *row, int size);
+void editorRowDropDisplay(erow *row);
+void editorColdLoad(editorColdBlock *block);
+void editorColdRelease(editorColdBlock *block);
+void editorColdFlush(editorConfig *E, char *raw, int rawlen, int *rows, int nrows);
+void editorColdIdle(editorConfig *E);
+void editorUpdateRow(editorConfig *E, erow *row);
+void editorRowExpandTabs(erow *row, char *render);
+int editorRowCxtoRx(erow *row, int cx);
+void editorRowInsertChar(editorConfig *E, erow *row, int at, int c);
+void editorRowDeleteChar(editorConfig *E, erow *row, int at);
+void editorRowAppendString(editorConfig *E, erow *row, char *s, size_t len);
+void editorFreeRow(erow *row);
+void editorDeleteRow(editorConfig *E, int at);
+
+/* Editor Operations */
+void editorInsertChar(editorConfig *E, int c);
+void editorDeleteChar(editorConfig *E);
+void editorInsertNewLine(editorConfig *E);
+
+/* Syntax Highlighting */
+int is_separator(int c);
+void editorInitSeparators();
+unsigned int editorKeywordHash(char *s, int len, unsigned int seed);
+void editorSyntaxCompileKeywords(editorSyntax *syntax);
+int editorSyntaxMatchKeyword(editorConfig *E, char *s, int len);
+void editorUpdateSyntax(editorConfig *E, erow *row, int start);
+void editorInvalidateSyntax(editorConfig *E, int at);
+void editorSyntaxUpdateUntil(editorConfig *E, int limit);
+void editorSyntaxUpdateRange(editorConfig *E, int from, int to);
+void editorSyntaxUpdateView(editorConfig *E);
+void editorSyntaxPrepareRow(editorConfig *E, erow *row);
+int editorSyntaxScanState(editorConfig *E, erow *row, int start);
+void editorSyntaxPrepass(editorConfig *E);
+void editorSyntaxIdle(editorConfig *E);
+void editorInitColors();
+void editorSetColor(abuf *ab, int *current, int hl);
+void editorSelectSyntaxHighlight(editorConfig *E);
+
+#endif
@@ -0,0 +1,160 @@
+#include <string.h>
+
+#include "lz.h"
+
+unsigned int lzHash(const unsigned char *p);
+unsigned char *lzPutLength(unsigned char *op, int len);
+
+unsigned int lzHash(const unsigned char *p) {
+    unsigned int v = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/// トークンに入りきらなかった長さ (len - 15) を書き込む関数
+unsigned char *lzPutLength(unsigned char *op, int len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = len;
+    return op;
+}
+
+/// src の n バイトを圧縮して dst に書き込み、その大きさを返す関数
+// cap が LZ_BOUND(n) 以上あれば必ず収まる。収まらない時は -1 を返す。
+// 4 バイトのハッシュで直前に同じ並びが出た位置を覚えておき、見つかった一致をそのまま使う (貪欲法)。
+int lzCompress(const char *src, int n, char *dst, int cap) {
+    const unsigned char *ip = (const unsigned char *) src;
+    const unsigned char *end = ip + n;
+    const unsigned char *anchor = ip;
+    unsigned char *op = (unsigned char *) dst;
+    unsigned char *op_end = op + cap;
+    int table[1 << LZ_HASH_BITS];
+    memset(table, -1, sizeof(table));
+
+    while (ip + LZ_MIN_MATCH <= end) {
+        unsigned int h = lzHash(ip);
+        int pos = ip - (const unsigned char *) src;
+        int candidate = table[h];
+        table[h] = pos;
+        if (candidate < 0 || pos - candidate > LZ_MAX_OFFSET ||
+            memcmp(src + candidate, ip, LZ_MIN_MATCH) != 0) {
+            ip++;
+            continue;
+        }
+
+        const unsigned char *match = (const unsigned char *) src + candidate;
+        int len = LZ_MIN_MATCH;
+        while (ip + len < end && match[len] == ip[len]) {
+            len++;
+        }
+
+        int literals = ip - anchor;
+        // トークン、長さ、リテラル、オフセットが入るか (長さは最大でも 255 ごとに 1 バイト)
+        if (op + 1 + literals / 255 + 1 + literals + 2 + len / 255 + 1 > op_end) {
+            return -1;
+        }
+        unsigned char *token = op++;
+        *token = (literals >= 15 ? 15 : literals) << 4;
+        if (literals >= 15) {
+            op = lzPutLength(op, literals - 15);
+        }
+        memcpy(op, anchor, literals);
+        op += literals;
+
+        int offset = pos - candidate;
+        *op++ = offset & 0xff;
+        *op++ = offset >> 8;
+        int extra = len - LZ_MIN_MATCH;
+        *token |= extra >= 15 ? 15 : extra;
+        if (extra >= 15) {
+            op = lzPutLength(op, extra - 15);
+        }
+
+        ip += len;
+        anchor = ip;
+    }
+
+    // 残りはリテラルだけのシーケンスにする
+    int literals = end - anchor;
+    if (op + 1 + literals / 255 + 1 + literals > op_end) {
+        return -1;
+    }
+    unsigned char *token = op++;
+    *token = (literals >= 15 ? 15 : literals) << 4;
+    if (literals >= 15) {
+        op = lzPutLength(op, literals - 15);
+    }
+    memcpy(op, anchor, literals);
+    op += literals;
+
+    return op - (unsigned char *) dst;
+}
+
+/// lzCompress で圧縮した src の n バイトを dst に展開し、その大きさを返す関数
+// データが壊れている時や cap に収まらない時は -1 を返す。
+int lzDecompress(const char *src, int n, char *dst, int cap) {
+    const unsigned char *ip = (const unsigned char *) src;
+    const unsigned char *end = ip + n;
+    unsigned char *op = (unsigned char *) dst;
+    unsigned char *op_end = op + cap;
+
+    while (ip < end) {
+        int token = *ip++;
+
+        int literals = token >> 4;
+        if (literals == 15) {
+            int c;
+            do {
+                if (ip >= end) {
+                    return -1;
+                }
+                c = *ip++;
+                literals += c;
+            } while (c == 255);
+        }
+        if (ip + literals > end || op + literals > op_end) {
+            return -1;
+        }
+        memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+
+        // 最後のシーケンス
+        if (ip >= end) {
+            break;
+        }
+
+        if (ip + 2 > end) {
+            return -1;
+        }
+        int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op - (unsigned char *) dst) {
+            return -1;
+        }
+
+        int len = (token & 15) + LZ_MIN_MATCH;
+        if ((token & 15) == 15) {
+            int c;
+            do {
+                if (ip >= end) {
+                    return -1;
+                }
+                c = *ip++;
+                len += c;
+            } while (c == 255);
+        }
+        if (op + len > op_end) {
+            return -1;
+        }
+        // 一致は自分自身と重なることがあるので、1 バイトずつ写す
+        unsigned char *match = op - offset;
+        for (int i = 0; i < len; i++) {
+            op[i] = match[i];
+        }
+        op += len;
+    }
+
+    return op - (unsigned char *) dst;
+}
@@ -0,0 +1,23 @@
+// 行のデータを圧縮するための、小さな LZ77 系の圧縮と展開 (外部のライブラリを使わない)
+//
+// 圧縮したデータはシーケンスの並び。1 つのシーケンスは次の形をしている。
+//   トークン (1 バイト)  上位 4 bit がリテラルの長さ、下位 4 bit が一致の長さ - LZ_MIN_MATCH
+//                        どちらも 15 の時は、続くバイトを 255 未満のバイトが出るまで足していく
+//   リテラル             そのままのバイト列
+//   オフセット (2 バイト) 一致している位置までの距離 (リトルエンディアン)
+// 最後のシーケンスはリテラルだけで、オフセットを持たない。
+#ifndef KEDITOR_LZ_H
+#define KEDITOR_LZ_H
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+// 一致を探すハッシュ表の大きさ (2 のべき乗の指数)
+#define LZ_HASH_BITS 12
+
+// n バイトを圧縮した時の最大の大きさ
+#define LZ_BOUND(n) ((n) + (n) / 255 + 16)
+
+int lzCompress(const char *src, int n, char *dst, int cap);
+int lzDecompress(const char *src, int n, char *dst, int cap);
+
+#endif
@@ -11,106 +11,98 @@
 #include <stdbool.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/ioctl.h>
-#include <time.h>
-#include <stdarg.h>
-#include <sys/types.h>
 #include <sys/stat.h>
-#include <fcntl.h>
-
-#define CTRL_KEY(value) ((value) & 0x1f)
-#define ABUF_INIT {NULL, 0}
-#define KEDITOR_VERSION "0.0.1"
-#define KEDITOR_TAB_STOP 8
-#define KEDITOR_QUIT_TIMES 2
-
-typedef struct editorConfig editorConfig;
-typedef struct abuf abuf;
-typedef struct erow erow;
+#include <sys/inotify.h>
+#include <poll.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "editor.h"
+#include "trace.h"
+#include "record.h"
+#include "stream.h"
+
+// 端末のフロントエンド。raw mode の設定とキーの読み込み、画面への書き込みだけを行い、
+// 編集の処理は editor.c に任せる。
+
+// 開いたファイルの書き換え、属性の変更 (touch など)、名前の付け替えや削除を監視する
+#define KEDITOR_WATCH_EVENTS (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF)
+// ファイルを読み込んでいる途中に、進み具合を描画し直す間隔 (ミリ秒)
+#define KEDITOR_LOAD_REDRAW_MS 100
+// この秒数だけ表示していない、未保存の変更の無いバッファのメモリを手放す
+#define KEDITOR_BUFFER_RELEASE_SECONDS 30
+
+// コマンドラインで指定したファイルごとのバッファ。
+// 表示しているバッファの状態は E にあり、切り替える時に buffers[current].E と入れ替える。
+typedef struct {
+    editorConfig E;
+    char *path;
+    // ファイルを読み込んだか (まだ表示していないバッファと、メモリを手放したバッファは読み込んでいない)
+    bool loaded;
+    // パイプから読み込んでいるバッファか (読み込み直せないので、メモリを手放さない)
+    bool stream;
+    // 表示しなくなった時刻
+    time_t hidden_since;
+    // メモリを手放した時のカーソルとスクロールの位置 (読み込み直した時に戻す)
+    int cx;
+    int cy;
+    int rowoff;
+    int coloff;
+} editorBuffer;
 
 void enableRauMode();
 void disableRauMode();
 void die(const char *msg);
+int editorReadInput(char *c);
+bool editorInputPending();
 int editorReadKey();
 void editorProcessKeypress();
 void editorRefreshScreen();
-void editorDrawRows();
 void initEditor();
+int getWindowSize(int *rows, int *cols);
 int getCursorPosition(int *rows, int *cols);
-void abAppend(abuf *ab, char *s, int len);
-void abFree(abuf *ab);
-void editorMoveCursor(int key);
-void editorOpen(char *filename);
-void editorAppendRow(int at, char *s, size_t len);
-void editorScroll();
-void editorUpdateRow(erow *row);
-int editorRowCxtoRx(erow *row, int cx);
-void editorDrawStatusBar(abuf *ab);
-void editorSetStatusMessage(const char *fmt, ...);
-void editorDrawMessageBar(abuf *ab);
-void editorRowInsertChar(erow *row, int at, int c);
-void editorInsertChar(int c);
-char *editorRowsToString(int *buflen);
-void editorSave();
-void editorInsertChar(int c);
-void editorDeleteChar();
-void editorFreeRow(erow *row);
-void editorDeleteRow(int at);
-void editorRowAppendString(erow *row, char *c, size_t len);
-void editorInsertNewLine();
 void *editorPrompt(char *prompt);
-
-struct erow {
-    int size;
-    char *chars;
-    int rsize;
-    char *render;
-};
-
-struct editorConfig {
-    int screenrows;
-    int screencols;
-    int cx;
-    int cy;
-    int rx;
-    int numrows;
-    erow *row;
-    int rowoff;
-    int coloff;
-    char *filename;
-    char statusmsg[80];
-    time_t statusmsg_time;
-    int dirty;
-    struct termios orig_termios;
-};
-
-struct abuf {
-    char *buf;
-    int len;
-};
-
-enum editorKey {
-    BACKSPACE = 127,
-    ARROW_UP = 1000,
-    ARROW_RIGHT,
-    ARROW_DOWN,
-    ARROW_LEFT,
-    DELETE_KEY,
-    HOME_KEY,
-    END_KEY,
-    PAGE_UP,
-    PAGE_DOWN,
-};
+int editorOpenStream(char *path);
+int editorStreamPoll();
+void editorWatchStart();
+int editorWatchPoll();
+char *editorCacheDir();
+void editorApplyOptions(editorConfig *config);
+void editorOpenBuffers(char **paths, int n, bool stream);
+void editorLoadBuffer(editorBuffer *b);
+void editorSwitchBuffer(int to);
+void editorBuffersIdle();
+int editorDirtyBuffers();
+#ifdef KEDITOR_PERF
+void editorPerfSample();
+void editorMemDump();
+#endif
 
 editorConfig E;
+struct termios orig_termios;
+// 開いたファイルを監視している inotify (ファイルを開いていなければ -1) と、
+// 表示しているバッファのファイルの監視 (watch descriptor。監視していなければ -1)、
+// 追記された分だけを読み込むか (KEDITOR_FOLLOW)
+// 表示していないバッファのファイルは監視せず、切り替えた時に確かめる。
+int watch_fd = -1;
+int watch_wd = -1;
+bool watch_follow = false;
+editorBuffer *buffers = NULL;
+int numbuffers = 0;
+int current = 0;
+// 他のバッファに未保存の変更がある時に、終了の確認を出したか
+bool quit_warned = false;
 
 void enableRauMode() {
-    if (tcgetattr(STDIN_FILENO, &E.orig_termios) == -1) {
+    if (tcgetattr(STDIN_FILENO, &orig_termios) == -1) {
         die("tcgetattr");
     }
     atexit(disableRauMode);
 
-    struct termios raw = E.orig_termios;
+    struct termios raw = orig_termios;
     // Ctrl + S, Ctrl + Q を無効化
     // Ctrl + J が 10 を取っているので、Enter と Ctrl + M を 10 から 13 に移行させる。
     raw.c_iflag &= ~(IXON | ICRNL | BRKINT | INPCK | ISTRIP);
@@ -132,7 +124,7 @@ void enableRauMode() {
 }
 
 void disableRauMode() {
-    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &E.orig_termios) == -1) {
+    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig_termios) == -1) {
         die("tcsetattr");
     }
 }
@@ -144,6 +136,21 @@ void die(const char *msg) {
     exit(EXIT_FAILURE);
 }
 
+/// 標準入力から 1 バイト読み込む関数 (記録中なら読んだバイトを記録する)
+int editorReadInput(char *c) {
+    int nread = read(STDIN_FILENO, c, 1);
+    if (nread == 1) {
+        recordInput(c, 1);
+    }
+    return nread;
+}
+
+/// 端末からの入力が届いていて、待たずに読めるかを返す関数
+bool editorInputPending() {
+    struct pollfd fd = {STDIN_FILENO, POLLIN, 0};
+    return poll(&fd, 1, 0) > 0;
+}
+
 /// 入力キーを変換する関数
 // 無限ループで入力を待ち受けるが、Enter を押すと、処理が終了する。
 // read() == 0 としている時にこれが生じる。
@@ -154,201 +161,132 @@ void die(const char *msg) {
 int editorReadKey() {
     int nread;
     char c;
+    double redrawn = editorPerfNow();
     // not= 1 にしないとマルチバイトに対応できない。
     // この処理がイマイチ納得いっていない。
-    while ((nread = read(STDIN_FILENO, &c, 1)) != 1) {
-        if (nread < 0 && errno != EAGAIN) {
-            die("read");
+    while (true) {
+        // ファイルを読み込んでいる途中は、キー入力が届くまで続きを読み込み、時々描画し直す
+        if (E.load && !editorInputPending()) {
+            editorLoadStep(&E, KEDITOR_LOAD_STEP_BYTES);
+            if (E.load == NULL || editorPerfNow() - redrawn >= KEDITOR_LOAD_REDRAW_MS) {
+                editorRefreshScreen();
+                redrawn = editorPerfNow();
+            }
+            continue;
         }
-    }
-
-    if (c == '\x1b') {
-        char seq[3];
-
-        if (read(STDIN_FILENO, &seq[0], 1) != 1) {
-            return '\x1b';
+        if ((nread = editorReadInput(&c)) == 1) {
+            break;
         }
-        if (read(STDIN_FILENO, &seq[1], 1) != 1) {
-            return '\x1b';
+        if (nread < 0 && errno != EAGAIN) {
+            die("read");
         }
-
-        if (seq[0] == '[') {
-            if (seq[1] >= '0' && seq[1] <= '9') {
-                if (read(STDIN_FILENO, &seq[2], 1) != 1) {
-                    return '\x1b';
-                }
-                // page キーと Delete キーの parse
-                if (seq[2] == '~') {
-                    switch (seq[1]) {
-                        case '1': return HOME_KEY; // 他プラットフォーム対応
-                        case '4': return END_KEY; // 他プラットフォーム対応
-                        case '3':
-                            return DELETE_KEY;
-                        case '5':
-                            return PAGE_UP;
-                        case '6':
-                            return PAGE_DOWN;
-                        case '7': return HOME_KEY; // 他プラットフォーム対応
-                        case '8': return END_KEY; // 他プラットフォーム対応
-                    }
-                }
-            } else {
-                switch (seq[1]) {
-                    // 矢印キーの parse
-                    case 'A':
-                        return ARROW_UP;
-                    case 'C':
-                        return ARROW_RIGHT;
-                    case 'B':
-                        return ARROW_DOWN;
-                    case 'D':
-                        return ARROW_LEFT;
-                    // Home, End キーの parse
-                    case 'H':
-                        return HOME_KEY;
-                    case 'F':
-                        return END_KEY;
-                }
-            }
-        } else if (seq[0] == 'O') {
-            switch (seq[1]) {
-                case 'H': return HOME_KEY; // 他プラットフォーム対応
-                case 'F': return END_KEY; // 他プラットフォーム対応
+        // キー入力が無い間に、パイプから届いた行や書き換えられたファイルを表示し、
+        // 画面外の行のハイライトを進め、画面から離れた行を圧縮しておく。
+        if (nread == 0) {
+            if (editorStreamPoll() + editorWatchPoll() > 0) {
+                editorRefreshScreen();
             }
+            editorIdle(&E);
+            editorBuffersIdle();
         }
-        return '\x1b';
-    } else {
-        return c;
     }
-}
-
-/// カーソルの座標を表す変数を変更する関数
-void editorMoveCursor(int key) {
-    erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
 
-    switch (key) {
-        case ARROW_UP:
-            if (E.cy != 0) {
-                E.cy--;
-            }
-            break;
-        case ARROW_DOWN:
-            if (E.cy < E.numrows) {
-                E.cy++;
-            }
-            break;
-        case ARROW_RIGHT:
-            if (row && E.cx < row->size) {
-                E.cx++;
-            } else if (row && E.cx == row->size) {
-                E.cy++;
-                E.cx = 0;
-            }
-            break;
-        case ARROW_LEFT:
-            if (E.cx != 0) {
-                E.cx--;
-            } else if (E.cy > 0) {
-                // E.cx > 0 の評価式にしないとファイルの一番先頭にカーソルがある状態で Left Arrow を押すと、異常終了してしまう。
-                E.cy--;
-                E.cx = E.row[E.cy].size;
-            }
-            break;
+    if (c != '\x1b') {
+        return (unsigned char) c;
     }
 
-    // 行末から行末の短い行に移動した時に、カーソルが行末に移動するようなロジック
-    row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
-    int rowlen = row ? row->size : 0;
-    if (E.cx > rowlen) {
-        E.cx = rowlen;
+    // エスケープシーケンスの残りを読み込んでから、editorDecodeKey で変換する。
+    char seq[4];
+    int len = 1;
+    seq[0] = c;
+    if (editorReadInput(&seq[1]) != 1) {
+        return '\x1b';
+    }
+    len++;
+    if (editorReadInput(&seq[2]) != 1) {
+        return '\x1b';
+    }
+    len++;
+    if (seq[1] == '[' && seq[2] >= '0' && seq[2] <= '9') {
+        if (editorReadInput(&seq[3]) != 1) {
+            return '\x1b';
+        }
+        len++;
     }
+
+    int used;
+    return editorDecodeKey(seq, len, &used);
 }
 
-/// 入力キーを変換して、それに対応する処理を呼び出す関数
+/// 入力キーを読み込んで、それに対応する処理を呼び出す関数
 void editorProcessKeypress() {
-    static int quit_times = KEDITOR_QUIT_TIMES;
-
+    TRACE_BEGIN(read);
     int c = editorReadKey();
+    TRACE_END("key read", read);
 
-    switch (c) {
-        // TODO
-        case '\r':
-            editorInsertNewLine();
-            break;
-        case CTRL_KEY('q'):
-            if (E.dirty > 0 && quit_times > 0) {
+#ifdef KEDITOR_PERF
+    double start = editorPerfNow();
+#endif
+    TRACE_BEGIN(dispatch);
+
+    int action = editorProcessKey(&E, c);
+    if (action != EDITOR_ACTION_QUIT) {
+        quit_warned = false;
+    }
+    switch (action) {
+        case EDITOR_ACTION_QUIT:
+            // 表示していないバッファの未保存の変更も、もう一度押すまで捨てない
+            if (!quit_warned && editorDirtyBuffers() > 0) {
                 editorSetStatusMessage(
-                    "WARNING!!! File has unsaved changes. "
-                    "Press Ctrl-Q %d more times to quit.",
-                    quit_times
+                    &E,
+                    "WARNING!!! %d other buffers have unsaved changes. "
+                    "Press Ctrl-Q again to quit.",
+                    editorDirtyBuffers()
                 );
-                quit_times--;
-                return;
+                quit_warned = true;
+                break;
             }
-
             write(STDOUT_FILENO, "\x1b[2J", 4);
             write(STDOUT_FILENO, "\x1b[H", 3);
             exit(EXIT_SUCCESS);
             break;
-        // 保存
-        case CTRL_KEY('s'):
-            editorSave();
-            break;
-        // 画面の左端か右端にカーソルを移動させる
-        case HOME_KEY:
-            E.cx = 0;
-            break;
-        case END_KEY:
-            if (E.cx < E.numrows) {
-                E.cx = E.row[E.cy].size;
+        case EDITOR_ACTION_SAVE:
+            if (E.filename == NULL) {
+                char *filename = editorPrompt("Save as : %s");
+                if (filename == NULL) {
+                    editorSetStatusMessage(&E, "Save aborted");
+                    break;
+                }
+                editorSetFilename(&E, filename);
+                free(filename);
             }
-            break;
-        // TODO
-        case BACKSPACE:
-        case CTRL_KEY('h'):
-        case DELETE_KEY:
-            // delete キーが押された時はカーソルを右にずらしてバックスペースで削除する実装にする。
-            // すなはちカーソルにある文字を削除する。
-            if (c == DELETE_KEY) {
-                editorMoveCursor(ARROW_RIGHT);
+            if (editorSave(&E) == 0) {
+                editorWatchStart();
             }
-            editorDeleteChar();
             break;
-        // 画面の一番上か一番下のカーソルを移動させる
-        case PAGE_UP:
-        case PAGE_DOWN:
+        case EDITOR_ACTION_NEXT_BUFFER:
+            editorSwitchBuffer(current + 1);
+            break;
+        case EDITOR_ACTION_PREV_BUFFER:
+            editorSwitchBuffer(current - 1);
+            break;
+        case EDITOR_ACTION_FILTER:
             {
-                if (c == PAGE_UP) {
-                    E.cy = E.rowoff;
-                } else if (c == PAGE_DOWN) {
-                    E.cy = E.rowoff + E.screenrows - 1;
-                }
-                if (E.cy > E.numrows) {
-                    E.cy = E.numrows;
-                }
-
-                int times = E.screenrows;
-                while (times--) {
-                    editorMoveCursor(c == PAGE_DOWN ? ARROW_DOWN : ARROW_UP);
+                char *pattern = editorPrompt("Filter : %s");
+                if (pattern == NULL) {
+                    break;
                 }
+                int count = editorFilterSet(&E, pattern, strlen(pattern));
+                editorSetStatusMessage(&E, "%d lines match \"%s\" (Ctrl-G to show all)", count, pattern);
+                free(pattern);
             }
             break;
-        case ARROW_UP:
-        case ARROW_RIGHT:
-        case ARROW_DOWN:
-        case ARROW_LEFT:
-            editorMoveCursor(c);
-            break;
-        // TODO
-        case CTRL_KEY('l'):
-        case '\x1b':
-            break;
-        default:
-            editorInsertChar(c);
-            break;
     }
 
-    quit_times = KEDITOR_QUIT_TIMES;
+    TRACE_END("key dispatch", dispatch);
+#ifdef KEDITOR_PERF
+    E.perf.key_ms = editorPerfNow() - start;
+#endif
 }
 
 int getWindowSize(int *rows, int *cols) {
@@ -394,250 +332,69 @@ int getCursorPosition(int *rows, int *cols) {
     return 0;
 }
 
-void editorDrawRows(abuf *ab) {
-    int y = 0;
-    for (y = 0; y < E.screenrows; y++) {
-        int filerow = y + E.rowoff;
-        if (filerow >= E.numrows) {
-            // Welcome Messsage を描画
-            if (E.numrows == 0 && y == E.screenrows / 3) {
-                char welcome[80];
-                int welcome_length = snprintf(welcome, sizeof(welcome), "Keditor -- version %s", KEDITOR_VERSION);
-                if (welcome_length > E.screencols) {
-                    welcome_length = E.screencols;
-                }
-                int padding = (E.screencols - welcome_length) / 2;
-                if (padding) {
-                    abAppend(ab, "~", 1);
-                    padding--;
-                }
-                while (padding--) {
-                    abAppend(ab, " ", 1);
-                }
-
-                abAppend(ab, welcome, welcome_length);
-            } else {
-                abAppend(ab, "~", 1);
-            }
-        } else {
-            int len = E.row[filerow].rsize - E.coloff;
-            if (len < 0) {
-                len = 0;
-            }
-            if (len > E.screencols) {
-                len = E.screencols;
-            }
-            abAppend(ab, &E.row[filerow].render[E.coloff], len);
-        }
-
-        // この行削除のエスケープシーケンスを書き込むことで、画面を消して上書きで書き込むことができる。
-        abAppend(ab, "\x1b[K", 3);
-        abAppend(ab, "\r\n", 2);
-    }
-}
-
-// E.cx を E.rx に変換する関数
-// Tab 文字が存在するときは、
-int editorRowCxtoRx(erow *row, int cx) {
-    //
-    int rx = 0;
-    for (int i = 0; i < cx; i++) {
-        if (row->chars[i] == '\t') {
-            rx += (KEDITOR_TAB_STOP - 1) - (rx % KEDITOR_TAB_STOP);
-        }
-        rx++;
-    }
-    return rx;
-}
-
-void editorScroll() {
-    E.rx = 0;
-    if (E.cy < E.numrows) {
-        E.rx = editorRowCxtoRx(&E.row[E.cy], E.cx);
-    }
-
-    // y 方向
-    if (E.cy < E.rowoff) {
-        E.rowoff = E.cy;
-    }
-    if (E.cy >= E.screenrows + E.rowoff) {
-        E.rowoff = E.cy - E.screenrows + 1;
-    }
-    // x 方向
-    if (E.rx < E.coloff) {
-        E.coloff = E.rx;
-    }
-    if (E.rx >= E.screencols + E.coloff) {
-        E.coloff = E.rx - E.screencols + 1;
-    }
-}
-
-void editorDrawStatusBar(abuf *ab) {
-    abAppend(ab, "\x1b[46m", 5);
-    // 左端に出すメッセージ
-    char status[80];
-    int len = snprintf(
-        status,
-        sizeof(status),
-        "%.20s - %d lines %s",
-        E.filename ? E.filename : "[No Name]" ,
-        E.numrows,
-        E.dirty > 0 ? "( modified )" : ""
-    );
-    abAppend(ab, status, len);
-    len = len > E.screencols ? E.screencols : len;
-    // 右端に出すメッセージ
-    char rstatus[80];
-    int rlen = snprintf(
-        rstatus, sizeof(rstatus), "%d/%d", E.cy + 1, E.numrows
-    );
-    while (len < E.screencols) {
-        if (E.screencols - len == rlen) {
-            abAppend(ab, rstatus, rlen);
-            break;
-        } else {
-            abAppend(ab, " ", 1);
-            len++;
-        }
-    }
-    abAppend(ab, "\x1b[m", 3);
-    abAppend(ab, "\r\n", 2);
-}
-
-void editorSetStatusMessage(const char *fmt, ...) {
-    va_list ap;
-
-    va_start(ap, fmt);
-    vsnprintf(E.statusmsg, sizeof(E.statusmsg), fmt, ap);
-    va_end(ap);
-    E.statusmsg_time = time(NULL);
-}
-
-void editorDrawMessageBar(abuf *ab) {
-    abAppend(ab, "\x1b[K", 3);
-    int msglen = strlen(E.statusmsg);
-    if (msglen > E.screencols) {
-        msglen = E.screencols;
-    }
-    if (msglen && time(NULL) - E.statusmsg_time < 5) {
-        abAppend(ab, E.statusmsg, msglen);
-    }
-}
-
 void editorRefreshScreen() {
-    editorScroll();
-
     abuf ab = ABUF_INIT;
 
-    abAppend(&ab, "\x1b[?25l", 6);
-    abAppend(&ab, "\x1b[H", 3);
-
-    editorDrawRows(&ab);
-    editorDrawStatusBar(&ab);
-    editorDrawMessageBar(&ab);
-
-    char buf[32];
-    // 絶対値 (E.cy) から相対値 (原点がウィンドウ) に変更する必要がある。
-    // この処理ではバグる。
-    // snprintf(buf, sizeof(buf), "\x1b[%d;%dH", (E.cy - E.rowoff) + 1 > E.numrows ? E.numrows : (E.cy - E.rowoff) + 1 , (E.rx - E.coloff) + 1);
-    snprintf(buf, sizeof(buf), "\x1b[%d;%dH", (E.cy - E.rowoff) + 1, (E.rx - E.coloff) + 1);
-    abAppend(&ab, buf, strlen(buf));
-    abAppend(&ab, "\x1b[?25h", 6);
-
-    write(STDOUT_FILENO, ab.buf, ab.len);
-    abFree(&ab);
-}
-
-void abAppend(abuf *ab, char *s, int len) {
-    char *new = realloc(ab->buf, ab->len + len);
-
-    if (new == NULL) {
-        return;
+#ifdef KEDITOR_PERF
+    if (E.perf.visible || E.perf.mem_visible) {
+        editorPerfSample();
     }
+    double start = editorPerfNow();
+#endif
 
-    memcpy(&new[ab->len], s, len);
-    ab->buf = new;
-    ab->len += len;
-}
+    editorRenderFrame(&E, &ab);
 
-void abFree(abuf *ab) {
-    free(ab->buf);
-}
+#ifdef KEDITOR_PERF
+    double rendered = editorPerfNow();
+#endif
 
-char *editorRowsToString(int *buflen) {
-    int total_length = 0;
-    int i = 0;
-    for (i = 0; i < E.numrows; i++) {
-        total_length += (E.row[i].size + 1);
-    }
-    *buflen = total_length;
+    TRACE_BEGIN(output);
+    write(STDOUT_FILENO, ab.buf, ab.len);
+    TRACE_END("write", output);
 
-    char *buf = malloc(sizeof(char) * total_length);
-    char *head = buf;
-    for (i = 0; i < E.numrows; i++) {
-        memcpy(head, E.row[i].chars, E.row[i].size);
-        head += E.row[i].size;
-        *head++ = '\n';
-    }
+#ifdef KEDITOR_PERF
+    E.perf.render_ms = rendered - start;
+    E.perf.write_ms = editorPerfNow() - rendered;
+    E.perf.frame_bytes = ab.len;
+    editorPerfEndFrame(&E);
+#endif
 
-    return buf;
+    abFree(&ab);
 }
 
-void editorSave() {
-    if (E.filename == NULL) {
-        E.filename = editorPrompt("Save as : %s");
-        if (E.filename == NULL) {
-            editorSetStatusMessage("Save aborted");
-            return;
+#ifdef KEDITOR_PERF
+/// 計測結果の表示用に、プロセスの RSS と読まれていない入力の量を調べる関数
+void editorPerfSample() {
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (fp) {
+        long size;
+        long resident;
+        if (fscanf(fp, "%ld %ld", &size, &resident) == 2) {
+            E.perf.rss_kb = resident * (sysconf(_SC_PAGESIZE) / 1024);
         }
+        fclose(fp);
     }
 
-    int len;
-    char *buf = editorRowsToString(&len);
-
-    int fd = open(E.filename, O_RDWR | O_CREAT, 0644);
-    if (fd != -1) {
-        if (ftruncate(fd, len) != -1) {
-            if (write(fd, buf, len) == len) {
-                E.dirty = 0;
-                close(fd);
-                free(buf);
-                editorSetStatusMessage("%d bytes written to disk", len);
-                return;
-            }
-        }
-        close(fd);
+    int queued = 0;
+    if (ioctl(STDIN_FILENO, FIONREAD, &queued) == 0) {
+        E.perf.input_queue = queued;
     }
-    free(buf);
-    editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
 }
 
-void editorOpen(char *filename) {
-    free(E.filename);
-    E.filename = strdup(filename);
-    FILE *fp = fopen(filename, "r");
+/// 終了時に、メモリの使用量の表を KEDITOR_MEMSTATS のファイル ("-" なら標準エラー出力) に書き出す関数
+void editorMemDump() {
+    char *path = getenv("KEDITOR_MEMSTATS");
+    FILE *fp = strcmp(path, "-") ? fopen(path, "w") : stderr;
     if (!fp) {
-        die("editorOpen");
+        return;
     }
-
-    char *line = NULL;
-    size_t linecap = 0;
-    ssize_t linelen;
-
-    // hogehoge != 1 にしていたため、改行があると、それ移行描画されない Bug が生じていた。
-    while ((linelen = getline(&line, &linecap, fp)) != -1) {
-        // E,row[hoge].chars に改行やキャリッジリターンを格納しない。
-        while (linelen > 0 && (line[linelen - 1] == '\r' || line[linelen - 1] == '\n')) {
-            linelen--;
-        }
-        editorAppendRow(E.numrows, line, linelen);
+    editorPerfSample();
+    editorMemReport(fp, E.perf.rss_kb);
+    if (fp != stderr) {
+        fclose(fp);
     }
-
-    E.dirty = 0;
-
-    free(line);
-    fclose(fp);
 }
+#endif
 
 void *editorPrompt(char *prompt) {
     size_t bufsize = 128;
@@ -647,7 +404,7 @@ void *editorPrompt(char *prompt) {
     buf[0] = '\0';
 
     while (true) {
-        editorSetStatusMessage(prompt, buf);
+        editorSetStatusMessage(&E, prompt, buf);
         editorRefreshScreen();
 
         int c = editorReadKey();
@@ -656,12 +413,12 @@ void *editorPrompt(char *prompt) {
                 buf[--buflen] = '\0';
             }
         } else if (c == '\x1b') {
-            editorSetStatusMessage("");
+            editorSetStatusMessage(&E, "");
             free(buf);
             return NULL;
         } else if (c == '\r') {
             if (buflen != 0) {
-                editorSetStatusMessage("");
+                editorSetStatusMessage(&E, "");
                 return buf;
             }
         } else if (!iscntrl(c) && c < 128) {
@@ -675,186 +432,334 @@ void *editorPrompt(char *prompt) {
     }
 }
 
-// ファイルから読み込んだ実体を表示用に変換する
-void editorUpdateRow(erow *row) {
-    free(row->render);
-    int tabs = 0;
-    for (int i = 0; i < row->size; i++) {
-        if (row->chars[i] == '\t') {
-            tabs++;
+/// path がパイプなら、バックグラウンドで読み込みながら表示し始める関数
+// "-" は標準入力を読み、キー入力は代わりに端末 (/dev/tty) から読む。標準入力が端末なら終了する。
+// パイプでなければ 0 を返すので、呼び出し側が editorOpen で開く。enableRauMode より先に呼ぶ。
+int editorOpenStream(char *path) {
+    int fd;
+    if (!strcmp(path, "-")) {
+        // 標準入力が端末の時は、読み込むスレッドとキー入力が同じ端末を取り合ってしまう
+        if (isatty(STDIN_FILENO)) {
+            fprintf(stderr, "keditor: standard input is a terminal; pipe a command into \"keditor -\"\n");
+            exit(EXIT_FAILURE);
+        }
+        fd = dup(STDIN_FILENO);
+        int tty = open("/dev/tty", O_RDWR);
+        if (fd < 0 || tty < 0 || dup2(tty, STDIN_FILENO) < 0) {
+            die("/dev/tty");
+        }
+        close(tty);
+    } else {
+        struct stat st;
+        if (stat(path, &st) < 0 || !S_ISFIFO(st.st_mode)) {
+            return 0;
+        }
+        fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            die("open");
         }
     }
-    row->render = malloc(sizeof(char) * (row->size + (KEDITOR_TAB_STOP - 1) * tabs + 1));
+    if (streamStart(fd) < 0) {
+        die("streamStart");
+    }
+    return 1;
+}
 
-    int j = 0;
-    int index = 0;
-    for (j = 0; j < row->size; j++) {
-        if (row->chars[j] == '\t') {
-            row->render[index++] = ' ';
-            while (index % KEDITOR_TAB_STOP != 0) {
-                row->render[index++] = ' ';
-            }
+/// パイプから届いた行をバッファに追加して、追加した行数を返す関数
+int editorStreamPoll() {
+    // パイプの行は、それを表示している時だけ取り出す (取り出さない間はスレッドが読むのを待つ)
+    if (!stream_active || (numbuffers > 0 && !buffers[current].stream)) {
+        return 0;
+    }
+    int rows = streamDrain(&E);
+    if (!stream_active) {
+        if (stream_error) {
+            editorSetStatusMessage(&E, "Read error: %s", strerror(stream_error));
         } else {
-            row->render[index++] = row->chars[j];
+            editorSetStatusMessage(&E, "%d lines read", E.numrows);
         }
+        // 最後の行が無くても、メッセージを出し直すために描画させる
+        return rows + 1;
     }
-    row->render[index] = '\0';
-    row->rsize = index;
+    return rows;
 }
 
-// 行を追加する関数
-void editorAppendRow(int at, char *s, size_t len) {
-    if (at < 0 || at > E.numrows) {
+/// 開いたファイルを inotify で監視し始める関数 (既に監視していれば E->filename を監視し直す)
+// それまで監視していた別のファイル (切り替える前のバッファのファイルや、名前を付け替える前のファイル) の監視は外す。
+// 監視できなくても編集には困らないので、追記を読み込む時 (watch_follow) 以外は黙って諦める。
+void editorWatchStart() {
+    if (E.filename == NULL) {
         return;
     }
-
-    E.row = realloc(E.row, sizeof(erow) * (E.numrows + 1));
-    memmove(&E.row[at + 1], &E.row[at], sizeof(erow) * (E.numrows - at));
-
-    E.row[at].size = len;
-    E.row[at].chars = malloc(sizeof(char) * (len + 1));
-    // ファイルの中身をグローバル変数 (E.row[at].chars) に格納する処理の実装
-    memcpy(E.row[at].chars, s, len);
-    E.row[at].chars[len] = '\0';
-    E.row[at].render = NULL;
-    E.row[at].rsize = 0;
-
-    editorUpdateRow(&E.row[at]);
-
-    E.numrows++;
-    E.dirty++;
-}
-
-void editorInsertNewLine() {
-    if (E.cx == 0) {
-        editorAppendRow(E.cy, "", 0);
-    } else {
-        erow *row = &E.row[E.cy];
-        editorAppendRow(E.cy + 1, &row->chars[E.cx], row->size - E.cx);
-        // editorAppendRow 内で realloc() が呼出されるので、E.row に割り当てられるアドレスが変更される可能性がある。
-        row = &E.row[E.cy];
-        row->size = E.cx;
-        row->chars[row->size] = '\0';
-        editorUpdateRow(row);
-    }
-    E.cy++;
-    E.cx = 0;
-}
-
-/* Row Operations */
-
-// 文字を挿入する関数
-void editorRowInsertChar(erow *row, int at, int c) {
-    if (at < 0 || at > row->size) {
-        at = row->size;
+    if (watch_fd < 0) {
+        watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
     }
-    row->chars = realloc(row->chars, sizeof(char) * (row->size + 2));
-    memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
-    row->chars[at] = c;
-    row->size++;
-    editorUpdateRow(row);
-    E.dirty++;
-}
-
-// 文字を削除刷る関数
-void editorRowDeleteChar(erow *row, int at) {
-    if (at < 0 || at > row->size) {
-        return;
+    int wd = watch_fd < 0 ? -1 : inotify_add_watch(watch_fd, E.filename, KEDITOR_WATCH_EVENTS);
+    // 同じファイル (inode) なら同じ wd が返るので、その時は外さない
+    if (watch_wd >= 0 && watch_wd != wd) {
+        inotify_rm_watch(watch_fd, watch_wd);
+    }
+    watch_wd = wd;
+    if (wd < 0 && watch_follow) {
+        die("inotify");
     }
-    memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
-    row->size--;
-    editorUpdateRow(row);
-    E.dirty++;
-}
-
-void editorFreeRow(erow *row) {
-    free(row->chars);
-    free(row->render);
 }
 
-void editorDeleteRow(int at) {
-    if (at < 0 || at >= E.numrows) {
-        return;
+/// 監視しているファイルが書き換えられていれば読み込み直して、描画し直す必要があれば正の値を返す関数
+// KEDITOR_FOLLOW の時は追記された分だけを読み込む。大きな追記は一度に読み切れないので、
+// 続きが残っていればイベントが無くても呼ばれる度に続きを読む。そうでなければ変わった行だけを読み込み直すが、
+// 未保存の変更がある時は読み込み直さずに知らせるだけにする (保存する時は editorProcessKey が確かめる)。
+int editorWatchPoll() {
+    // 読み込んでいる途中のイベントは、読み込み終わってから見る
+    if (watch_fd < 0 || E.load) {
+        return 0;
+    }
+    // 表示しているファイルのイベントだけを見る。外した監視のイベント (外す前に溜まっていた分と IN_IGNORED) は
+    // 読み捨てて、ファイルを読み直したりハッシュを取り直したりしない。一度に読み切れなかった分は次の呼び出しで読む。
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len = read(watch_fd, events, sizeof(events));
+    bool event = false;
+    for (char *p = events; p < events + len; p += sizeof(struct inotify_event) + ((struct inotify_event *) p)->len) {
+        if (((struct inotify_event *) p)->wd == watch_wd) {
+            event = true;
+        }
+    }
+    if (event) {
+        // 別のファイルに書いてから名前を付け替えて保存するエディタもあるので、今その名前のファイルを監視し直す
+        int wd = inotify_add_watch(watch_fd, E.filename, KEDITOR_WATCH_EVENTS);
+        if (watch_wd >= 0 && watch_wd != wd) {
+            inotify_rm_watch(watch_fd, watch_wd);
+        }
+        watch_wd = wd;
+    }
+    if (watch_follow) {
+        return event || E.follow_pending ? editorFollow(&E) : 0;
+    }
+    if (!event) {
+        return 0;
+    }
+    if (!editorFileChanged(&E)) {
+        return 0;
+    }
+    if (E.dirty) {
+        editorSetStatusMessage(&E, "WARNING!!! %s changed on disk (unsaved changes kept)", E.filename);
+        return 1;
     }
-    editorFreeRow(&E.row[at]);
-    memmove(&E.row[at], &E.row[at + 1], sizeof(erow) * (E.numrows - at - 1));
-    E.numrows--;
-    E.dirty++;
+    int changed = editorReload(&E);
+    if (changed < 0) {
+        editorSetStatusMessage(&E, "Can't reload! I/O error: %s", strerror(errno));
+    } else if (changed > 0) {
+        editorSetStatusMessage(&E, "%s changed on disk: %d lines reloaded", E.filename, changed);
+    }
+    return 1;
 }
 
-void editorRowAppendString(erow *row, char *s, size_t len) {
-    row->chars = realloc(row->chars, row->size + len + 1);
-    memcpy(&row->chars[row->size], s, len);
-    row->size += len;
-    row->chars[row->size] = '\0';
-    editorUpdateRow(row);
-    E.dirty++;
+/// 索引のキャッシュを置くディレクトリを返す関数 (キャッシュしない時は NULL)
+char *editorCacheDir() {
+    char *dir = getenv("KEDITOR_CACHE_DIR");
+    if (dir) {
+        return strcmp(dir, "") && strcmp(dir, "0") ? strdup(dir) : NULL;
+    }
+    char path[4096];
+    char *xdg = getenv("XDG_CACHE_HOME");
+    char *home = getenv("HOME");
+    if (xdg && xdg[0] == '/') {
+        snprintf(path, sizeof(path), "%s/keditor", xdg);
+    } else if (home) {
+        snprintf(path, sizeof(path), "%s/.cache/keditor", home);
+    } else {
+        return NULL;
+    }
+    return strdup(path);
+}
+
+/// 環境変数で指定した設定をバッファに反映する関数 (バッファを作るたびに呼ぶ)
+void editorApplyOptions(editorConfig *config) {
+    // KEDITOR_INTERN を指定すると、同じ内容の行の文字列を共有してファイルを読み込む
+    char *intern = getenv("KEDITOR_INTERN");
+    config->intern_lines = intern && strcmp(intern, "") && strcmp(intern, "0");
+    // KEDITOR_FOLLOW=scroll の時は、最後の行にいれば追記された行までカーソルを動かす
+    char *follow = getenv("KEDITOR_FOLLOW");
+    config->follow_scroll = follow && !strcmp(follow, "scroll");
+    // 大きなファイルの行の索引は KEDITOR_CACHE_DIR (無ければ $XDG_CACHE_HOME/keditor か ~/.cache/keditor) にキャッシュする。
+    // KEDITOR_CACHE_DIR=0 でキャッシュしない。
+    config->cache_dir = editorCacheDir();
+}
+
+/// コマンドラインで指定したファイルのバッファを作る関数
+// 表示する最初のバッファは E のまま呼び出し側が読み込み始める。
+// 残りはファイル名を覚えておくだけにして、切り替えて表示する時に初めて読み込む。
+void editorOpenBuffers(char **paths, int n, bool stream) {
+    buffers = calloc(n, sizeof(editorBuffer));
+    numbuffers = n;
+    for (int i = 0; i < n; i++) {
+        editorBuffer *b = &buffers[i];
+        b->path = paths[i];
+        b->loaded = i == 0;
+        b->stream = i == 0 && stream;
+        if (i > 0) {
+            editorInit(&b->E, E.screenrows, E.screencols);
+            editorApplyOptions(&b->E);
+        }
+    }
 }
 
-/* Editor Operations */
-
-// 文字の挿入とカーソルの移動
-void editorInsertChar(int c) {
-    if (E.cy ==  E.numrows) {
-        editorAppendRow(E.numrows, "", 0);
+/// 読み込んでいなかったバッファ (今は E にある) のファイルを読み込み始める関数
+// メモリを手放す前に表示していた位置まで読み込んで、カーソルとスクロールの位置を戻す。
+void editorLoadBuffer(editorBuffer *b) {
+    if (editorOpenBegin(&E, b->path) < 0) {
+        // まだ無いファイルは空のバッファにして、保存した時に作る
+        editorSetFilename(&E, b->path);
+        if (errno != ENOENT) {
+            editorSetStatusMessage(&E, "Can't open %s: %s", b->path, strerror(errno));
+        }
     }
-    editorRowInsertChar(&E.row[E.cy], E.cx, c);
-    E.cx++;
+    editorLoadUntil(&E, b->cy + E.screenrows + 1);
+    editorLoadRows(&E, b->rowoff, b->cy + E.screenrows + 1);
+    E.cy = b->cy < E.numrows ? b->cy : E.numrows;
+    E.rowoff = b->rowoff < E.cy ? b->rowoff : E.cy;
+    E.coloff = b->coloff;
+    int rowlen = E.cy < E.numrows ? E.row[E.cy].size : 0;
+    E.cx = b->cx < rowlen ? b->cx : rowlen;
+    b->loaded = true;
 }
 
-// カーソルの右側にある文字を削除し、カーソルを移動する関数
-void editorDeleteChar() {
-    if (E.cy == E.numrows) {
+/// to 番目のバッファに切り替える関数 (端を越えたら反対の端に回る)
+void editorSwitchBuffer(int to) {
+    if (numbuffers < 2) {
+        editorSetStatusMessage(&E, "No other buffers");
         return;
     }
-    if (E.cx == 0 && E.cy == 0) {
-        return;
-    }
-
-    erow *row = &E.row[E.cy];
-    if (E.cx > 0) {
-        editorRowDeleteChar(row, E.cx - 1);
-        E.cx--;
-    } else {
-        E.cx = E.row[E.cy - 1].size;
-        editorRowAppendString(&E.row[E.cy - 1], row->chars, row->size);
-        editorDeleteRow(E.cy);
-        E.cy--;
+    to = (to + numbuffers) % numbuffers;
+    buffers[current].E = E;
+    buffers[current].hidden_since = time(NULL);
+    current = to;
+    E = buffers[current].E;
+
+    editorBuffer *b = &buffers[current];
+    if (!b->loaded) {
+        editorLoadBuffer(b);
+    } else if (watch_follow && E.load == NULL) {
+        // 表示していない間に追記された分を読み込む (残りはキー入力を待つ間に読む)
+        editorFollow(&E);
+    } else if (!E.dirty && editorFileChanged(&E)) {
+        // 表示していない間に書き換えられていれば、変わった行を読み込み直す
+        editorReload(&E);
+    }
+    // 前のバッファが書いた画面を、分けたウィンドウも含めて全て書き直す
+    editorWindowRedrawAll(&E);
+    editorWatchStart();
+    editorSetStatusMessage(&E, "[%d/%d] %s", current + 1, numbuffers, E.filename ? E.filename : "[No Name]");
+}
+
+/// しばらく表示していないバッファのメモリを手放す関数 (キー入力を待つ間に呼ぶ)
+// 未保存の変更があるバッファとパイプのバッファは残す。手放したバッファは次に表示する時に読み込み直す。
+void editorBuffersIdle() {
+    time_t now = time(NULL);
+    bool released = false;
+    for (int i = 0; i < numbuffers; i++) {
+        editorBuffer *b = &buffers[i];
+        if (i == current || !b->loaded || b->stream || b->E.dirty ||
+            now - b->hidden_since < KEDITOR_BUFFER_RELEASE_SECONDS) {
+            continue;
+        }
+        b->cx = b->E.cx;
+        b->cy = b->E.cy;
+        b->rowoff = b->E.rowoff;
+        b->coloff = b->E.coloff;
+        editorFree(&b->E);
+        // 分けていたウィンドウは戻さず、画面全体の大きさで作り直す
+        int rows, cols;
+        editorWindowArea(&E, &rows, &cols);
+        editorInit(&b->E, rows, cols);
+        editorApplyOptions(&b->E);
+        b->loaded = false;
+        released = true;
+    }
+#ifdef __GLIBC__
+    // 解放した領域を OS に返す (glibc は返さずに持っておくことがある)
+    if (released) {
+        malloc_trim(0);
+    }
+#else
+    (void) released;
+#endif
+}
+
+/// 表示していないバッファのうち、未保存の変更があるものの数を返す関数
+int editorDirtyBuffers() {
+    int count = 0;
+    for (int i = 0; i < numbuffers; i++) {
+        if (i != current && buffers[i].loaded && buffers[i].E.dirty) {
+            count++;
+        }
     }
+    return count;
 }
 
 void initEditor() {
-    E.cx = 0;
-    E.cy = 0;
-    E.rx = 0;
-    E.numrows = 0;
-    E.row = NULL;
-    E.rowoff = 0;
-    E.coloff = 0;
-    E.filename = NULL;
-    E.statusmsg[0] = '\0';
-    E.statusmsg_time = 0;
-    E.dirty = 0;
-    if (getWindowSize(&E.screenrows, &E.screencols) < 0) {
+    int rows;
+    int cols;
+    if (getWindowSize(&rows, &cols) < 0) {
         die("getWindowSize");
     }
-    E.screenrows -= 2;
+    editorInit(&E, rows - 2, cols);
+    editorApplyOptions(&E);
+
+    // KEDITOR_RECORD にファイル名を指定すると、キー入力を記録する (replay.out で再生できる)
+    char *record = getenv("KEDITOR_RECORD");
+    if (record && recordStart(record, rows, cols) < 0) {
+        die("recordStart");
+    }
 }
 
 int main(int argc, char **argv) {
+    // KEDITOR_TRACE にファイル名を指定すると、終了時にトレースを書き出す
+    char *trace = getenv("KEDITOR_TRACE");
+    if (trace) {
+        traceInit(trace);
+    }
+#ifdef KEDITOR_MEM_ACCOUNT
+    // 端末の設定を戻した後に書き出すように、enableRauMode より先に登録する
+    if (getenv("KEDITOR_MEMSTATS")) {
+        atexit(editorMemDump);
+    }
+#endif
+
+    bool stream = argc >= 2 && editorOpenStream(argv[1]);
     enableRauMode();
     initEditor();
-
+    // keditor *.log のように複数のファイルを指定すると、それぞれをバッファにして Ctrl-N / Ctrl-B で切り替える
     if (argc >= 2) {
-        editorOpen(argv[1]);
+        editorOpenBuffers(argv + 1, argc - 1, stream);
     }
 
-    editorSetStatusMessage("HELP: Ctrl-Q = quit | Ctrl-S = save");
+    if (argc >= 2 && !stream) {
+        // 最初の画面の分だけ読み込んですぐに描画し、残りはキー入力を待つ間に読み込む
+        if (editorOpenBegin(&E, argv[1]) < 0) {
+            die("editorOpen");
+        }
+        editorLoadUntil(&E, E.screenrows);
+        editorLoadRows(&E, 0, E.screenrows);
+        // KEDITOR_FOLLOW を指定すると、ファイルに追記された行を読み込み続ける (tail -f のように使う)。
+        // 指定しなければ、他のプロセスがファイルを書き換えた時に変わった行を読み込み直す。
+        char *follow = getenv("KEDITOR_FOLLOW");
+        watch_follow = follow && strcmp(follow, "") && strcmp(follow, "0");
+        editorWatchStart();
+    }
+
+    if (numbuffers > 1) {
+        editorSetStatusMessage(&E, "HELP: Ctrl-Q = quit | Ctrl-S = save | Ctrl-N / Ctrl-B = next / prev buffer");
+    } else {
+        editorSetStatusMessage(&E, "HELP: Ctrl-Q = quit | Ctrl-S = save | Ctrl-W = split window | Ctrl-G = filter");
+    }
 
     while (true) {
+        editorStreamPoll();
+        editorWatchPoll();
         editorRefreshScreen();
         editorProcessKeypress();
     }
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,143 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "record.h"
+
+double recordNowUs();
+void recordPutVarint(unsigned long value);
+int recordGetVarint(FILE *fp, unsigned long *value);
+
+bool record_enabled = false;
+
+FILE *record_fp = NULL;
+double record_last = 0;
+
+double recordNowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+void recordPutVarint(unsigned long value) {
+    while (value >= 0x80) {
+        fputc((value & 0x7f) | 0x80, record_fp);
+        value >>= 7;
+    }
+    fputc(value, record_fp);
+}
+
+int recordGetVarint(FILE *fp, unsigned long *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = fgetc(fp);
+        if (c == EOF) {
+            return -1;
+        }
+        *value |= (unsigned long) (c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/// path に入力の記録を始める関数
+// 終了時 (exit) に recordStop が呼ばれるようにする。
+int recordStart(const char *path, int rows, int cols) {
+    record_fp = fopen(path, "wb");
+    if (!record_fp) {
+        return -1;
+    }
+
+    fwrite(KEDITOR_RECORD_MAGIC, 1, 4, record_fp);
+    fputc(KEDITOR_RECORD_VERSION, record_fp);
+    fputc(rows & 0xff, record_fp);
+    fputc((rows >> 8) & 0xff, record_fp);
+    fputc(cols & 0xff, record_fp);
+    fputc((cols >> 8) & 0xff, record_fp);
+
+    record_last = recordNowUs();
+    record_enabled = true;
+    atexit(recordStop);
+    return 0;
+}
+
+/// 読み込んだ入力のバイト列を、前の入力からの経過時間と一緒に記録する関数
+void recordInput(const char *buf, int len) {
+    if (!record_enabled || len <= 0) {
+        return;
+    }
+    double now = recordNowUs();
+    recordPutVarint((unsigned long) (now - record_last));
+    recordPutVarint(len);
+    fwrite(buf, 1, len, record_fp);
+    record_last = now;
+}
+
+void recordStop() {
+    if (!record_enabled) {
+        return;
+    }
+    record_enabled = false;
+    fclose(record_fp);
+    record_fp = NULL;
+}
+
+/// 記録したファイルを開いてヘッダを読む関数 (形式が違う時は -1 を返す)
+int recordOpen(recordReader *r, const char *path) {
+    r->fp = fopen(path, "rb");
+    if (!r->fp) {
+        return -1;
+    }
+
+    unsigned char header[9];
+    if (fread(header, 1, sizeof(header), r->fp) != sizeof(header) ||
+        memcmp(header, KEDITOR_RECORD_MAGIC, 4) != 0 ||
+        header[4] != KEDITOR_RECORD_VERSION) {
+        fclose(r->fp);
+        r->fp = NULL;
+        return -1;
+    }
+    r->rows = header[5] | (header[6] << 8);
+    r->cols = header[7] | (header[8] << 8);
+    return 0;
+}
+
+/// 次のイベントを読む関数
+// 読んだバイト数を返す。ファイルの終わりでは 0、壊れている時は -1 を返す。
+int recordNext(recordReader *r, long *delta_us, char *buf, int bufsize) {
+    unsigned long delta;
+    unsigned long len;
+
+    int c = fgetc(r->fp);
+    if (c == EOF) {
+        return 0;
+    }
+    ungetc(c, r->fp);
+
+    if (recordGetVarint(r->fp, &delta) < 0 || recordGetVarint(r->fp, &len) < 0) {
+        return -1;
+    }
+    if (len == 0 || len > (unsigned long) bufsize) {
+        return -1;
+    }
+    if (fread(buf, 1, len, r->fp) != len) {
+        return -1;
+    }
+    *delta_us = delta;
+    return len;
+}
+
+void recordClose(recordReader *r) {
+    if (r->fp) {
+        fclose(r->fp);
+        r->fp = NULL;
+    }
+}
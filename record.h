@@ -0,0 +1,35 @@
+// キー入力の記録 (セッションの記録と再生)
+// 端末から読み込んだバイトを、時刻と一緒にバイナリのファイルへ書き出す。
+// 書き出したファイルは replay.out でエディタの中核に流し込み直せる。
+//
+// ファイルの形式 (数値はリトルエンディアン)
+//   ヘッダ    "KREC" (4 バイト), 版 (1 バイト), 端末の行数 (2 バイト), 端末の列数 (2 バイト)
+//   イベント  前のイベントからの経過時間 (µs, 可変長整数), バイト数 (可変長整数), 入力のバイト列
+// 可変長整数は下位 7 bit ずつ並べ、続きがある時は最上位 bit を立てる (LEB128)。
+#ifndef KEDITOR_RECORD_H
+#define KEDITOR_RECORD_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define KEDITOR_RECORD_MAGIC "KREC"
+#define KEDITOR_RECORD_VERSION 1
+
+// 記録したファイルを読むための状態
+typedef struct {
+    FILE *fp;
+    int rows;
+    int cols;
+} recordReader;
+
+// 入力を記録しているか (recordStart を呼んだか)
+extern bool record_enabled;
+
+int recordStart(const char *path, int rows, int cols);
+void recordInput(const char *buf, int len);
+void recordStop();
+int recordOpen(recordReader *r, const char *path);
+int recordNext(recordReader *r, long *delta_us, char *buf, int bufsize);
+void recordClose(recordReader *r);
+
+#endif
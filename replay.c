@@ -0,0 +1,326 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "editor.h"
+#include "record.h"
+
+// KEDITOR_RECORD で記録したキー入力を、端末を使わずにエディタの中核へ流し込み直すプログラム。
+// main.c の editorReadKey と同じ区切り方でキーに直し、1 キーごとに画面を組み立てて時間を測る。
+//
+// 既定では待たずに最後まで流し込む。-p を付けると記録した時の間隔で流し込む。
+// どちらでも、記録で 100ms 以上入力が無かった所では、main.c と同じ回数だけ editorIdle を呼ぶ。
+
+// main.c の raw mode の VTIME (read が 0 を返すまでの時間)
+#define REPLAY_READ_TIMEOUT_US 100000
+
+typedef struct {
+    editorConfig E;
+    // 記録した入力のバイト列と、記録を始めてからの各バイトの時刻 (µs)
+    char *input;
+    double *times;
+    int len;
+    int pos;
+    bool paced;
+    bool write;
+    bool quit;
+    double start;
+    long keys;
+    long frames;
+    long long bytes;
+    long idles;
+    long saves;
+    // 1 キーあたりの処理と画面の組み立ての時間 (µs)。保存のプロンプトの入力は測らない。
+    double *latency;
+    long measured;
+} replayState;
+
+void usage();
+double replayNow();
+int replayLoad(replayState *st, char *path, int *rows, int *cols);
+void replayWait(replayState *st, double target);
+int replayReadByte(replayState *st, char *c, bool first);
+int replayReadKey(replayState *st);
+void replayRenderFrame(replayState *st);
+void replayPrompt(replayState *st);
+void replayFeedKey(replayState *st, int c);
+int replayCompareDouble(const void *a, const void *b);
+
+void usage() {
+    fprintf(stderr,
+        "Usage: replay.out [-p] [-w] trace [file]\n"
+        "  -p  記録した時の間隔で入力を流し込む\n"
+        "  -w  Ctrl-S で実際にファイルへ保存する (既定では保存しない)\n");
+    exit(EXIT_FAILURE);
+}
+
+double replayNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/// 記録したファイルを全て読み込む関数
+int replayLoad(replayState *st, char *path, int *rows, int *cols) {
+    recordReader r;
+    if (recordOpen(&r, path) < 0) {
+        return -1;
+    }
+    *rows = r.rows;
+    *cols = r.cols;
+
+    int cap = 0;
+    double now = 0;
+    char buf[256];
+    long delta;
+    int n;
+    while ((n = recordNext(&r, &delta, buf, sizeof(buf))) > 0) {
+        if (st->len + n > cap) {
+            cap = cap ? cap * 2 : 1024;
+            while (cap < st->len + n) {
+                cap *= 2;
+            }
+            st->input = realloc(st->input, cap);
+            st->times = realloc(st->times, sizeof(double) * cap);
+        }
+        now += delta;
+        for (int i = 0; i < n; i++) {
+            st->input[st->len] = buf[i];
+            st->times[st->len] = now;
+            st->len++;
+        }
+    }
+    recordClose(&r);
+    return n < 0 ? -1 : 0;
+}
+
+/// 次のバイトの時刻まで待つ関数
+// main.c では read が 100ms ごとに 0 を返して editorIdle を呼ぶので、同じ回数だけ呼ぶ。
+void replayWait(replayState *st, double target) {
+    double previous = st->pos > 0 ? st->times[st->pos - 1] : 0;
+    long idles = (long) ((target - previous) / REPLAY_READ_TIMEOUT_US);
+    for (long i = 0; i < idles; i++) {
+        if (st->paced) {
+            double wake = st->start + previous + (i + 1) * REPLAY_READ_TIMEOUT_US;
+            double now = replayNow();
+            if (wake > now) {
+                usleep((useconds_t) (wake - now));
+            }
+        }
+        editorIdle(&st->E);
+        st->idles++;
+    }
+    if (st->paced) {
+        double now = replayNow();
+        if (st->start + target > now) {
+            usleep((useconds_t) (st->start + target - now));
+        }
+    }
+}
+
+/// 次のバイトを読む関数 (main.c の read 1 回に当たる)
+// エスケープシーケンスの続き (first が false) は、100ms 以上空いていれば読めなかった扱いにする。
+int replayReadByte(replayState *st, char *c, bool first) {
+    if (st->pos >= st->len) {
+        return 0;
+    }
+    if (!first && st->times[st->pos] - st->times[st->pos - 1] >= REPLAY_READ_TIMEOUT_US) {
+        return 0;
+    }
+    if (first) {
+        replayWait(st, st->times[st->pos]);
+    }
+    *c = st->input[st->pos++];
+    return 1;
+}
+
+/// main.c の editorReadKey と同じ区切り方で、次のキーを返す関数 (入力が終われば -1)
+int replayReadKey(replayState *st) {
+    char c;
+    if (!replayReadByte(st, &c, true)) {
+        return -1;
+    }
+    if (c != '\x1b') {
+        return (unsigned char) c;
+    }
+
+    char seq[4];
+    int len = 1;
+    seq[0] = c;
+    if (!replayReadByte(st, &seq[1], false)) {
+        return '\x1b';
+    }
+    len++;
+    if (!replayReadByte(st, &seq[2], false)) {
+        return '\x1b';
+    }
+    len++;
+    if (seq[1] == '[' && seq[2] >= '0' && seq[2] <= '9') {
+        if (!replayReadByte(st, &seq[3], false)) {
+            return '\x1b';
+        }
+        len++;
+    }
+
+    int used;
+    return editorDecodeKey(seq, len, &used);
+}
+
+void replayRenderFrame(replayState *st) {
+    abuf ab = ABUF_INIT;
+    editorRenderFrame(&st->E, &ab);
+    st->frames++;
+    st->bytes += ab.len;
+    abFree(&ab);
+}
+
+/// main.c の editorPrompt と同じように、保存するファイル名の入力を読み進める関数
+void replayPrompt(replayState *st) {
+    char buf[256];
+    int buflen = 0;
+    buf[0] = '\0';
+
+    while (true) {
+        editorSetStatusMessage(&st->E, "Save as : %s", buf);
+        replayRenderFrame(st);
+
+        int c = replayReadKey(st);
+        if (c < 0) {
+            return;
+        }
+        st->keys++;
+        if (c == DELETE_KEY || c == CTRL_KEY('h') || c == BACKSPACE) {
+            if (buflen != 0) {
+                buf[--buflen] = '\0';
+            }
+        } else if (c == '\x1b') {
+            editorSetStatusMessage(&st->E, "Save aborted");
+            return;
+        } else if (c == '\r') {
+            if (buflen != 0) {
+                editorSetStatusMessage(&st->E, "");
+                if (st->write) {
+                    editorSetFilename(&st->E, buf);
+                    editorSave(&st->E);
+                }
+                st->saves++;
+                return;
+            }
+        } else if (!iscntrl(c) && c < 128 && buflen < (int) sizeof(buf) - 1) {
+            buf[buflen++] = c;
+            buf[buflen] = '\0';
+        }
+    }
+}
+
+/// キーを 1 つ処理して画面を組み立て、かかった時間を記録する関数
+void replayFeedKey(replayState *st, int c) {
+    st->keys++;
+    double start = replayNow();
+
+    switch (editorProcessKey(&st->E, c)) {
+        case EDITOR_ACTION_QUIT:
+            st->quit = true;
+            break;
+        case EDITOR_ACTION_SAVE:
+            if (st->E.filename == NULL) {
+                replayPrompt(st);
+                replayRenderFrame(st);
+                return;
+            }
+            if (st->write) {
+                editorSave(&st->E);
+            }
+            st->saves++;
+            break;
+    }
+    if (!st->quit) {
+        replayRenderFrame(st);
+    }
+
+    st->latency[st->measured++] = replayNow() - start;
+}
+
+int replayCompareDouble(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+    replayState st;
+    memset(&st, 0, sizeof(st));
+
+    int opt;
+    while ((opt = getopt(argc, argv, "pw")) != -1) {
+        switch (opt) {
+            case 'p':
+                st.paced = true;
+                break;
+            case 'w':
+                st.write = true;
+                break;
+            default:
+                usage();
+        }
+    }
+    if (optind >= argc) {
+        usage();
+    }
+
+    int rows;
+    int cols;
+    if (replayLoad(&st, argv[optind], &rows, &cols) < 0) {
+        fprintf(stderr, "%s: not a keditor record\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+    if (rows < 3 || cols < 1) {
+        fprintf(stderr, "%s: invalid terminal size %dx%d\n", argv[optind], rows, cols);
+        return EXIT_FAILURE;
+    }
+    // キーの数は入力のバイト数を超えない
+    st.latency = malloc(sizeof(double) * (st.len + 1));
+
+    editorInit(&st.E, rows - 2, cols);
+    if (optind + 1 < argc && editorOpen(&st.E, argv[optind + 1]) < 0) {
+        perror("editorOpen");
+        return EXIT_FAILURE;
+    }
+    editorSetStatusMessage(&st.E, "HELP: Ctrl-Q = quit | Ctrl-S = save");
+
+    st.start = replayNow();
+    replayRenderFrame(&st);
+    int c;
+    while (!st.quit && (c = replayReadKey(&st)) >= 0) {
+        replayFeedKey(&st, c);
+    }
+    double elapsed = replayNow() - st.start;
+
+    long measured = st.measured;
+    qsort(st.latency, measured, sizeof(double), replayCompareDouble);
+    double p50 = measured ? st.latency[measured / 2] : 0;
+    double p99 = measured ? st.latency[(long) (measured * 0.99)] : 0;
+    double max = measured ? st.latency[measured - 1] : 0;
+
+    printf("{\"trace\":\"%s\",\"mode\":\"%s\",\"rows\":%d,\"cols\":%d,\"input_bytes\":%d,"
+           "\"keys\":%ld,\"frames\":%ld,\"bytes\":%lld,\"idles\":%ld,\"saves\":%ld,"
+           "\"elapsed_s\":%.6f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f}\n",
+           argv[optind], st.paced ? "paced" : "fast", rows, cols, st.len,
+           st.keys, st.frames, st.bytes, st.idles, st.saves,
+           elapsed / 1e6, p50, p99, max);
+
+    free(st.input);
+    free(st.times);
+    free(st.latency);
+    editorFree(&st.E);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,257 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+
+#include "editor.h"
+#include "sidecar.h"
+
+int sidecarPath(const char *dir, sidecarHeader *header, char *buf, int size);
+int sidecarMakeDir(const char *dir);
+bool sidecarRead(int fd, void *buf, size_t len);
+bool sidecarWrite(int fd, void *buf, size_t len);
+unsigned char *sidecarEncodeOffsets(int64_t *offsets, int n, size_t *size);
+bool sidecarDecodeOffsets(unsigned char *buf, size_t size, int64_t *offsets, int n, int64_t limit);
+
+/// キーのファイル名 (inode ごとに 1 つ) を buf に書き込む関数
+int sidecarPath(const char *dir, sidecarHeader *header, char *buf, int size) {
+    int len = snprintf(buf, size, "%s/%llx-%llx.idx", dir,
+                       (unsigned long long) header->dev, (unsigned long long) header->ino);
+    return len < size ? 0 : -1;
+}
+
+/// dir と、まだ無ければその親のディレクトリを作る関数 (mkdir -p)
+int sidecarMakeDir(const char *dir) {
+    char path[4096];
+    int len = snprintf(path, sizeof(path), "%s", dir);
+    if (len >= (int) sizeof(path)) {
+        return -1;
+    }
+    for (char *p = path + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            if (mkdir(path, 0700) < 0 && errno != EEXIST) {
+                return -1;
+            }
+            *p = '/';
+        }
+    }
+    if (mkdir(path, 0700) < 0 && errno != EEXIST) {
+        return -1;
+    }
+    return 0;
+}
+
+bool sidecarRead(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool sidecarWrite(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+/// 行の位置を、前の位置との差の可変長整数に詰める関数 (*size に詰めた大きさを入れる)
+unsigned char *sidecarEncodeOffsets(int64_t *offsets, int n, size_t *size) {
+    // 差は 64 bit なので、1 つ 10 バイトあれば足りる
+    unsigned char *buf = editorMalloc(MEM_SCRATCH, (size_t) n * 10 + 1);
+    size_t len = 0;
+    int64_t prev = 0;
+    for (int i = 0; i < n; i++) {
+        uint64_t delta = offsets[i] - prev;
+        prev = offsets[i];
+        while (delta >= 0x80) {
+            buf[len++] = (delta & 0x7f) | 0x80;
+            delta >>= 7;
+        }
+        buf[len++] = delta;
+    }
+    *size = len;
+    return buf;
+}
+
+/// sidecarEncodeOffsets で詰めた行の位置を offsets (n 個) に戻す関数
+// 個数が合わない時や、位置が増えていない時、ファイルの大きさ limit を超える時は false を返す。
+bool sidecarDecodeOffsets(unsigned char *buf, size_t size, int64_t *offsets, int n, int64_t limit) {
+    size_t at = 0;
+    int64_t prev = 0;
+    for (int i = 0; i < n; i++) {
+        uint64_t delta = 0;
+        int shift = 0;
+        while (true) {
+            if (at >= size || shift > 63) {
+                return false;
+            }
+            unsigned char byte = buf[at++];
+            delta |= (uint64_t) (byte & 0x7f) << shift;
+            shift += 7;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        // 最初の行は 0 から始まり、それ以降は前の行より後ろにある
+        if ((i == 0 && delta != 0) || (i > 0 && delta == 0) || delta > (uint64_t) (limit - prev)) {
+            return false;
+        }
+        prev += delta;
+        offsets[i] = prev;
+    }
+    return at == size;
+}
+
+/// 大きさ size のファイル fd の、所々を読んだ内容のハッシュを *hash に入れる関数
+// ファイルの全体は読まず、KEDITOR_SIDECAR_SAMPLES 箇所を等間隔に読んでハッシュ (FNV-1a) を取る。
+// 大きさと更新時刻が同じまま中身が変わったことを、安く見つけるために使う。
+int sidecarSampleHash(int fd, long size, uint64_t *hash) {
+    uint64_t h = 14695981039346656037ULL;
+    unsigned char buf[KEDITOR_SIDECAR_SAMPLE_BYTES];
+    long span = size > KEDITOR_SIDECAR_SAMPLE_BYTES ? size - KEDITOR_SIDECAR_SAMPLE_BYTES : 0;
+    for (int i = 0; i < KEDITOR_SIDECAR_SAMPLES; i++) {
+        long at = span / (KEDITOR_SIDECAR_SAMPLES - 1) * i;
+        ssize_t n = pread(fd, buf, sizeof(buf), at);
+        if (n < 0) {
+            return -1;
+        }
+        for (ssize_t j = 0; j < n; j++) {
+            h ^= buf[j];
+            h *= 1099511628211ULL;
+        }
+    }
+    *hash = h;
+    return 0;
+}
+
+/// 開いたファイル fd のキーを index のヘッダに設定する関数
+// 大きさと更新時刻が同じまま中身が変わった時に古いキャッシュを使わないように、内容のハッシュもキーに含める。
+int sidecarKey(sidecarIndex *index, int fd, struct stat *st) {
+    sidecarHeader *header = &index->header;
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, KEDITOR_SIDECAR_MAGIC, sizeof(header->magic));
+    header->version = KEDITOR_SIDECAR_VERSION;
+    header->dev = st->st_dev;
+    header->ino = st->st_ino;
+    header->size = st->st_size;
+    header->mtime = st->st_mtim.tv_sec;
+    header->mtime_nsec = st->st_mtim.tv_nsec;
+    return sidecarSampleHash(fd, header->size, &header->sample);
+}
+
+/// キーが一致するキャッシュを読み込む関数 (index のヘッダには sidecarKey でキーを設定しておく)
+// 見つからない時や、ファイルが書き換えられていて古い時は -1 を返す。
+int sidecarLoad(const char *dir, sidecarIndex *index) {
+    index->offsets = NULL;
+    index->hl = NULL;
+    char path[4096];
+    if (sidecarPath(dir, &index->header, path, sizeof(path)) < 0) {
+        return -1;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    sidecarHeader header;
+    sidecarHeader *key = &index->header;
+    if (!sidecarRead(fd, &header, sizeof(header)) ||
+        memcmp(header.magic, key->magic, sizeof(header.magic)) != 0 || header.version != key->version ||
+        header.dev != key->dev || header.ino != key->ino || header.size != key->size ||
+        header.mtime != key->mtime || header.mtime_nsec != key->mtime_nsec || header.sample != key->sample ||
+        header.numrows < 0 ||
+        header.noffsets != (header.numrows + KEDITOR_SIDECAR_STRIDE - 1) / KEDITOR_SIDECAR_STRIDE ||
+        header.offsets_size < 0 || header.offsets_size > (int64_t) header.noffsets * 10) {
+        close(fd);
+        return -1;
+    }
+    header.filetype[sizeof(header.filetype) - 1] = '\0';
+
+    size_t packed_size = header.offsets_size;
+    unsigned char *packed = editorMalloc(MEM_SCRATCH, packed_size + 1);
+    int64_t *offsets = editorMalloc(MEM_SCRATCH, sizeof(int64_t) * header.noffsets + 1);
+    size_t hl_size = header.has_hl ? ((size_t) header.numrows + 7) / 8 : 0;
+    unsigned char *hl = hl_size ? editorMalloc(MEM_SCRATCH, hl_size) : NULL;
+    bool ok = sidecarRead(fd, packed, packed_size) &&
+              sidecarDecodeOffsets(packed, packed_size, offsets, header.noffsets, header.size) &&
+              (hl == NULL || sidecarRead(fd, hl, hl_size));
+    editorMemFree(packed);
+    close(fd);
+    if (!ok) {
+        editorMemFree(offsets);
+        editorMemFree(hl);
+        return -1;
+    }
+
+    index->header = header;
+    index->offsets = offsets;
+    index->hl = hl;
+    return 0;
+}
+
+/// index をキャッシュのディレクトリに書き出す関数
+// 途中で止まっても壊れたファイルが残らないように、別の名前で書いてから名前を付け替える。
+int sidecarSave(const char *dir, sidecarIndex *index) {
+    char path[4096];
+    char tmp[4096 + 32];
+    if (sidecarMakeDir(dir) < 0 || sidecarPath(dir, &index->header, path, sizeof(path)) < 0) {
+        return -1;
+    }
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int) getpid());
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+
+    sidecarHeader *header = &index->header;
+    size_t packed_size;
+    unsigned char *packed = sidecarEncodeOffsets(index->offsets, header->noffsets, &packed_size);
+    header->offsets_size = packed_size;
+    size_t hl_size = header->has_hl ? ((size_t) header->numrows + 7) / 8 : 0;
+    bool ok = sidecarWrite(fd, header, sizeof(*header)) &&
+              sidecarWrite(fd, packed, packed_size) &&
+              (hl_size == 0 || sidecarWrite(fd, index->hl, hl_size));
+    editorMemFree(packed);
+    if (close(fd) < 0) {
+        ok = false;
+    }
+    if (!ok || rename(tmp, path) < 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+void sidecarFree(sidecarIndex *index) {
+    editorMemFree(index->offsets);
+    editorMemFree(index->hl);
+    index->offsets = NULL;
+    index->hl = NULL;
+}
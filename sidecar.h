@@ -0,0 +1,62 @@
+// 大きなファイルの行の索引のキャッシュ (サイドカー)
+// editorOpen が読み込んだ結果 (行数、所々の行の位置、ハイライトの状態) をキャッシュのディレクトリに書き出しておき、
+// 同じファイルを開き直した時に使う。開き直した時は行数がすぐに分かり、行の位置から必要な所だけを読み込める。ファイルは inode ごとに 1 つで、大きさ、更新時刻と、
+// 所々を読んだ内容のハッシュが一致した時だけ使う。
+//
+// ファイルの形式 (数値はこの環境のバイト順。同じ環境で書いて読むキャッシュなので変換しない)
+//   ヘッダ      sidecarHeader
+//   行の位置    KEDITOR_SIDECAR_STRIDE 行ごとの行の先頭のバイト位置 (noffsets 個)。
+//               前の位置との差を可変長整数 (7 bit ずつ、続きがあれば最上位 bit を立てる) で並べる (offsets_size バイト)
+//   ハイライト  行末でブロックコメントが閉じていないか (1 行 1 bit, has_hl の時だけ)
+#ifndef KEDITOR_SIDECAR_H
+#define KEDITOR_SIDECAR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#define KEDITOR_SIDECAR_MAGIC "KIDX"
+#define KEDITOR_SIDECAR_VERSION 3
+// これより小さいファイルは読み込むのに時間がかからないので、キャッシュしない
+#define KEDITOR_SIDECAR_MIN_BYTES (16 << 20)
+// 行の位置を覚えておく間隔 (行数)。開き直した時は、この行数ずつ読み込む
+#define KEDITOR_SIDECAR_STRIDE 1024
+// 内容のハッシュを取るために読む箇所の数と、1 箇所の大きさ
+#define KEDITOR_SIDECAR_SAMPLES 16
+#define KEDITOR_SIDECAR_SAMPLE_BYTES 4096
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    // キー (ファイルの状態と、所々を読んだ内容のハッシュ)
+    uint64_t dev;
+    uint64_t ino;
+    int64_t size;
+    int64_t mtime;
+    int64_t mtime_nsec;
+    uint64_t sample;
+    // 読み込んだ結果
+    int32_t numrows;
+    int32_t noffsets;
+    int64_t offsets_size;
+    int64_t file_offset;
+    uint8_t file_tail;
+    uint8_t has_hl;
+    uint8_t pad[6];
+    // ハイライトの状態を計算した時のファイルの種類
+    char filetype[32];
+} sidecarHeader;
+
+typedef struct {
+    sidecarHeader header;
+    int64_t *offsets;
+    unsigned char *hl;
+} sidecarIndex;
+
+int sidecarSampleHash(int fd, long size, uint64_t *hash);
+int sidecarKey(sidecarIndex *index, int fd, struct stat *st);
+int sidecarLoad(const char *dir, sidecarIndex *index);
+int sidecarSave(const char *dir, sidecarIndex *index);
+void sidecarFree(sidecarIndex *index);
+
+#endif
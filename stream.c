@@ -0,0 +1,156 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "stream.h"
+#include "trace.h"
+
+void *streamReader(void *arg);
+
+bool stream_active = false;
+int stream_error = 0;
+
+int stream_fd = -1;
+// スレッドが読み込んで、まだ取り出されていないバイト列 (stream_lock で守る)
+pthread_mutex_t stream_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t stream_space = PTHREAD_COND_INITIALIZER;
+char *stream_buf = NULL;
+size_t stream_len = 0;
+size_t stream_cap = 0;
+bool stream_eof = false;
+
+/// fd を読み込むスレッドを始める関数 (fd は読み終わった時に閉じる)
+int streamStart(int fd) {
+    stream_fd = fd;
+    stream_active = true;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, streamReader, NULL) != 0) {
+        stream_active = false;
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+/// パイプを読み続けるスレッド
+// 取り出されていない分が KEDITOR_STREAM_BUFFER_BYTES を超えたら、取り出されるまで待つ。
+// ただし 1 行も終わっていない時 (とても長い行の途中) は待たずに読み進める。
+void *streamReader(void *arg) {
+    (void) arg;
+    traceSetThreadName("stream");
+    char *chunk = malloc(KEDITOR_STREAM_CHUNK);
+
+    while (true) {
+        ssize_t n = read(stream_fd, chunk, KEDITOR_STREAM_CHUNK);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        pthread_mutex_lock(&stream_lock);
+        if (n <= 0) {
+            stream_error = n < 0 ? errno : 0;
+            stream_eof = true;
+            pthread_mutex_unlock(&stream_lock);
+            break;
+        }
+        while (stream_len >= KEDITOR_STREAM_BUFFER_BYTES && memchr(stream_buf, '\n', stream_len)) {
+            pthread_cond_wait(&stream_space, &stream_lock);
+        }
+        if (stream_len + n > stream_cap) {
+            stream_cap = stream_cap ? stream_cap * 2 : KEDITOR_STREAM_CHUNK * 4;
+            while (stream_cap < stream_len + n) {
+                stream_cap *= 2;
+            }
+            stream_buf = realloc(stream_buf, stream_cap);
+        }
+        memcpy(stream_buf + stream_len, chunk, n);
+        stream_len += n;
+        pthread_mutex_unlock(&stream_lock);
+    }
+
+    free(chunk);
+    close(stream_fd);
+    return NULL;
+}
+
+/// スレッドが読み込んだ行をバッファの末尾に追加して、追加した行数を返す関数
+// 終わっている行だけを KEDITOR_STREAM_DRAIN_BYTES 程度まで取り出し、最後の改行の無い行は読み終わった時に追加する。
+// 読み込んだ行は編集ではないので E->dirty は変えない。
+int streamDrain(editorConfig *E) {
+    if (!stream_active) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&stream_lock);
+    size_t window = stream_len < KEDITOR_STREAM_DRAIN_BYTES ? stream_len : KEDITOR_STREAM_DRAIN_BYTES;
+    char *newline = NULL;
+    if (stream_len > 0) {
+        newline = memrchr(stream_buf, '\n', window);
+        if (newline == NULL && window < stream_len) {
+            newline = memchr(stream_buf + window, '\n', stream_len - window);
+        }
+    }
+    size_t take = newline ? (size_t) (newline - stream_buf) + 1 : 0;
+    if (stream_eof && newline == NULL) {
+        take = stream_len;
+    }
+    bool finished = stream_eof && take == stream_len;
+
+    char *data = NULL;
+    if (take > 0) {
+        data = editorMalloc(MEM_SCRATCH, take);
+        memcpy(data, stream_buf, take);
+        memmove(stream_buf, stream_buf + take, stream_len - take);
+        stream_len -= take;
+        pthread_cond_signal(&stream_space);
+    }
+    if (finished) {
+        free(stream_buf);
+        stream_buf = NULL;
+        stream_cap = 0;
+    }
+    pthread_mutex_unlock(&stream_lock);
+
+    int rows = 0;
+    if (data == NULL) {
+        if (finished) {
+            stream_active = false;
+        }
+        return 0;
+    }
+
+    TRACE_BEGIN(span);
+    int dirty = E->dirty;
+    char *p = data;
+    char *end = data + take;
+    while (p < end) {
+        char *eol = memchr(p, '\n', end - p);
+        char *next = eol ? eol + 1 : end;
+        if (eol == NULL) {
+            eol = end;
+        }
+        // editorOpen と同じく、行末の改行とキャリッジリターンは格納しない
+        while (eol > p && eol[-1] == '\r') {
+            eol--;
+        }
+        editorLoadRow(E, p, eol - p);
+        rows++;
+        p = next;
+    }
+    E->dirty = dirty;
+    editorMemFree(data);
+    TRACE_END("stream drain", span);
+
+    if (finished) {
+        stream_active = false;
+    }
+    return rows;
+}
@@ -0,0 +1,26 @@
+// パイプからの読み込み (keditor - で標準入力を表示する)
+// バックグラウンドのスレッドがパイプを読み続け、読み込んだ行はフロントエンドが
+// streamDrain を呼んだ時にバッファの末尾へ追加する (エディタの中核はスレッドをまたいで触らない)。
+#ifndef KEDITOR_STREAM_H
+#define KEDITOR_STREAM_H
+
+#include <stdbool.h>
+
+#include "editor.h"
+
+// スレッドが一度に read するバイト数
+#define KEDITOR_STREAM_CHUNK (64 * 1024)
+// 取り出されずに溜まっている分がこれを超えたら、スレッドは読むのを待つ
+#define KEDITOR_STREAM_BUFFER_BYTES (32 << 20)
+// streamDrain が一度に取り出す大きさの目安 (行の途中では切らない)
+#define KEDITOR_STREAM_DRAIN_BYTES (8 << 20)
+
+// パイプを読んでいる途中か (最後の行を取り出すと false になる)
+extern bool stream_active;
+// 読み込みに失敗した時の errno (最後まで読めた時は 0)
+extern int stream_error;
+
+int streamStart(int fd);
+int streamDrain(editorConfig *E);
+
+#endif
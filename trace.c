@@ -0,0 +1,173 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "trace.h"
+
+// 区間 (Chrome Trace Event の "X" イベント) 1 つ分
+typedef struct {
+    const char *name;
+    double start_us;
+    double dur_us;
+} traceEvent;
+
+// スレッド 1 つ分のリングバッファ。
+// 書き込むのは持ち主のスレッドだけで、head を進めるのはイベントを書き終えた後なので、ロックは要らない。
+// スレッドが終わるとバッファは空きになり、次に作られたスレッドが tid ごと引き継ぐ
+// (何度も作り直すワーカーのスレッドでも、バッファと tid は同時に動くスレッドの数しか増えない)。
+typedef struct traceBuffer {
+    traceEvent events[KEDITOR_TRACE_RING_SIZE];
+    unsigned long head;
+    // 使っているスレッドがあるか
+    int busy;
+    int tid;
+    const char *name;
+    struct traceBuffer *next;
+} traceBuffer;
+
+double traceNowUs();
+traceBuffer *traceLocalBuffer();
+void traceReleaseBuffer(void *buffer);
+
+bool trace_enabled = false;
+
+char *trace_path = NULL;
+double trace_origin = 0;
+// 全てのスレッドのバッファのリスト (先頭に CAS で繋ぐ)
+traceBuffer *trace_buffers = NULL;
+int trace_next_tid = 1;
+__thread traceBuffer *trace_local = NULL;
+// スレッドが終わった時にバッファを空きに戻すためのキー
+pthread_key_t trace_key;
+
+double traceNowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/// 呼び出したスレッドのバッファを返す関数
+// 初めての時は、終わったスレッドのバッファが空いていればそれを使い、無ければ作ってリストに繋ぐ。
+traceBuffer *traceLocalBuffer() {
+    if (trace_local != NULL) {
+        return trace_local;
+    }
+    traceBuffer *buffer;
+    for (buffer = __atomic_load_n(&trace_buffers, __ATOMIC_ACQUIRE); buffer; buffer = buffer->next) {
+        int idle = 0;
+        if (__atomic_compare_exchange_n(&buffer->busy, &idle, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    if (buffer == NULL) {
+        buffer = calloc(1, sizeof(traceBuffer));
+        if (buffer == NULL) {
+            return NULL;
+        }
+        buffer->busy = 1;
+        buffer->tid = __atomic_fetch_add(&trace_next_tid, 1, __ATOMIC_RELAXED);
+
+        buffer->next = __atomic_load_n(&trace_buffers, __ATOMIC_ACQUIRE);
+        while (!__atomic_compare_exchange_n(&trace_buffers, &buffer->next, buffer, false,
+                                            __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+        }
+    }
+
+    pthread_setspecific(trace_key, buffer);
+    trace_local = buffer;
+    return buffer;
+}
+
+/// スレッドが終わる時に、そのスレッドのバッファを空きに戻す関数 (記録したイベントは残す)
+void traceReleaseBuffer(void *buffer) {
+    __atomic_store_n(&((traceBuffer *) buffer)->busy, 0, __ATOMIC_RELEASE);
+}
+
+/// path にトレースを書き出すようにする関数
+// 終了時 (exit) に traceFlush が呼ばれるようにする。
+void traceInit(const char *path) {
+    trace_path = strdup(path);
+    trace_origin = traceNowUs();
+    pthread_key_create(&trace_key, traceReleaseBuffer);
+    trace_enabled = true;
+    traceSetThreadName("main");
+    atexit(traceFlush);
+}
+
+void traceSetThreadName(const char *name) {
+    if (!trace_enabled) {
+        return;
+    }
+    traceBuffer *buffer = traceLocalBuffer();
+    if (buffer) {
+        buffer->name = name;
+    }
+}
+
+/// 区間の始まりの時刻を返す関数
+double traceBegin() {
+    if (!trace_enabled) {
+        return 0;
+    }
+    return traceNowUs();
+}
+
+/// traceBegin から今までを name という区間として記録する関数
+void traceEnd(const char *name, double start) {
+    if (!trace_enabled) {
+        return;
+    }
+    traceBuffer *buffer = traceLocalBuffer();
+    if (buffer == NULL) {
+        return;
+    }
+    double now = traceNowUs();
+    traceEvent *event = &buffer->events[buffer->head % KEDITOR_TRACE_RING_SIZE];
+    event->name = name;
+    event->start_us = start - trace_origin;
+    event->dur_us = now - start;
+    __atomic_store_n(&buffer->head, buffer->head + 1, __ATOMIC_RELEASE);
+}
+
+/// 全てのスレッドのバッファを JSON として書き出す関数
+// 他のスレッドが書き込みを終えた後 (終了時) に呼ぶ。
+void traceFlush() {
+    if (!trace_enabled) {
+        return;
+    }
+    trace_enabled = false;
+
+    FILE *fp = fopen(trace_path, "w");
+    if (!fp) {
+        return;
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (traceBuffer *buffer = __atomic_load_n(&trace_buffers, __ATOMIC_ACQUIRE);
+         buffer; buffer = buffer->next) {
+        unsigned long head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+        unsigned long count = head < KEDITOR_TRACE_RING_SIZE ? head : KEDITOR_TRACE_RING_SIZE;
+
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                "\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", buffer->tid, buffer->name ? buffer->name : "thread");
+        first = false;
+
+        for (unsigned long i = head - count; i < head; i++) {
+            traceEvent *event = &buffer->events[i % KEDITOR_TRACE_RING_SIZE];
+            fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f}",
+                    event->name, buffer->tid, event->start_us, event->dur_us);
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+}
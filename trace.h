@@ -0,0 +1,29 @@
+// Chrome Trace Event 形式 (chrome://tracing や Perfetto で開ける JSON) でのトレースの記録
+// スレッドごとのリングバッファに書き込み、終了時にまとめてファイルへ書き出す。
+#ifndef KEDITOR_TRACE_H
+#define KEDITOR_TRACE_H
+
+#include <stdbool.h>
+
+// 1 スレッドが覚えておくイベントの数。溢れたら古いものから上書きする。
+#define KEDITOR_TRACE_RING_SIZE 65536
+
+// トレースを取るか (traceInit を呼んだか)
+extern bool trace_enabled;
+
+void traceInit(const char *path);
+void traceFlush();
+void traceSetThreadName(const char *name);
+double traceBegin();
+void traceEnd(const char *name, double start);
+
+// KEDITOR_PERF を定義せずにビルドした時はトレースのコードごと消える
+#ifdef KEDITOR_PERF
+#define TRACE_BEGIN(var) double var = traceBegin()
+#define TRACE_END(name, var) traceEnd(name, var)
+#else
+#define TRACE_BEGIN(var)
+#define TRACE_END(name, var)
+#endif
+
+#endif